@@ -0,0 +1,295 @@
+/**
+ * Mehrband-Überblendung (Burt und Adelson) gewarpter Bilder.
+ *
+ * Jedes Bild wird in eine Laplace-Pyramide zerlegt, seine Gewichte (Abstand
+ * zum Rand seines projizierten Vierecks) in eine Gauß-Pyramide. Pro Stufe
+ * wird mit den Gewichten gemittelt und das Ergebnis wieder zusammengesetzt:
+ * grobe Stufen werden über breite Übergänge geblendet, feine über schmale, so
+ * dass weder Nähte noch Geisterbilder entstehen. Lücken außerhalb eines Bildes werden vor der Zerlegung per
+ * normierter Faltung aufgefüllt, damit der Rand nicht in die groben Stufen
+ * dunkel einblutet.
+ *
+ * Die Leinwand wird kachelweise verarbeitet: Für jede Kachel werden die
+ * Pyramiden nur über der Kachel plus einem Rand (apron) aufgebaut, der den
+ * Einzugsbereich aller Stufen abdeckt und auf das Raster der gröbsten Stufe
+ * ausgerichtet ist. Gespeichert werden nur die Quellbilder und ihre
+ * Homographien: Bild und Gewicht werden für jedes Kachelfenster neu über
+ * PerspectiveWarp::span gewarpt bzw. berechnet (das Gewicht ist im konvexen
+ * Viereck das Minimum der Abstände zu seinen vier Kanten, also ohne
+ * Distanztransformation über das ganze Bild). Der Speicherbedarf hängt damit
+ * von Kachelgröße und Stufenzahl ab, nicht von der Größe der Leinwand oder
+ * der gewarpten Bilder; dafür werden die Ränder der Fenster mehrfach
+ * gewarpt.
+ */
+
+#ifndef BLEND_H
+#define BLEND_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <cv.h>
+
+#include "tiledcanvas.h"
+
+class MultiBandBlender {
+public:
+	/**
+	 * Leinwand area (Koordinaten der Zielebene) vom Typ CV_32FC(n) mit levels
+	 * Laplace-Stufen unter der vollen Auflösung; tileSize wird auf ein
+	 * Vielfaches von 2^levels aufgerundet. Mit executor werden die Zeilen der
+	 * Fenster parallel gewarpt.
+	 */
+	MultiBandBlender(const cv::Rect &area, int type, int levels = 5, int tileSize = 512, RowBandExecutor *executor = 0)
+		: area(area), type(type), levels(levels), executor(executor) {
+		CV_Assert(CV_MAT_DEPTH(type) == CV_32F && levels >= 0 && levels < 16 && tileSize > 0);
+		int unit = 1 << levels;
+		this->tileSize = (tileSize + unit - 1) / unit * unit;
+		// Einzugsbereich: 2^(l+1) - 2 Pixel beim Verkleinern bis Stufe l, etwa
+		// ebenso viel beim Vergrößern zurück, aufgerundet auf das Raster
+		margin = 4 * unit;
+	}
+
+	/** Rand um jede Kachel, über den die Pyramiden gebildet werden */
+	int apron() const { return margin; }
+
+	/**
+	 * Bild image (Typ der Leinwand, mindestens 2x2) mit der Homographie H
+	 * (Bild → Zielebene). Das Gewicht eines Pixels ist sein euklidischer
+	 * Abstand zum Rand des projizierten Vierecks plus eins, wie die
+	 * Distanztransformation der Maske mit ungültigem Rand. image wird nicht
+	 * kopiert und muss bis finish() erhalten bleiben.
+	 */
+	void add(const cv::Mat &image, const cv::Mat &H) {
+		CV_Assert(image.type() == type);
+		cv::Mat_<double> h;
+		H.convertTo(h, CV_64F);
+		inputs.push_back(Input(image, h, projectedBounds(h, image.size()) - area.tl()));
+		Input &input = inputs.back();
+
+		// Kanten der projizierten Ecken als a x + b y + c, innen positiv
+		cv::Size size = image.size();
+		double corners[4][2] = { { 0, 0 }, { size.width - 1.0, 0 }, { size.width - 1.0, size.height - 1.0 }, { 0, size.height - 1.0 } };
+		cv::Point2d p[4], center(0, 0);
+		for (int i = 0; i < 4; ++i) {
+			double x = corners[i][0], y = corners[i][1], w = h(2, 0) * x + h(2, 1) * y + h(2, 2);
+			p[i] = cv::Point2d((h(0, 0) * x + h(0, 1) * y + h(0, 2)) / w - area.x, (h(1, 0) * x + h(1, 1) * y + h(1, 2)) / w - area.y);
+			center.x += p[i].x / 4;
+			center.y += p[i].y / 4;
+		}
+		for (int i = 0; i < 4; ++i) {
+			cv::Point2d d = p[(i + 1) % 4] - p[i];
+			double length = std::sqrt(d.x * d.x + d.y * d.y);
+			double *e = input.edges[i];
+			if (length <= 0) {
+				e[0] = e[1] = 0;
+				e[2] = HUGE_VAL;
+				continue;
+			}
+			e[0] = -d.y / length;
+			e[1] = d.x / length;
+			e[2] = -(e[0] * p[i].x + e[1] * p[i].y);
+			if (e[0] * center.x + e[1] * center.y + e[2] < 0) {
+				for (int k = 0; k < 3; ++k)
+					e[k] = -e[k];
+			}
+		}
+	}
+
+	/**
+	 * Überblendet die Leinwand kachelweise und gibt die Kacheln in
+	 * Zeilenreihenfolge an writer (leer, wo kein Bild liegt).
+	 */
+	void finish(TileWriter &writer) {
+		cv::Mat out;
+		for (int y = 0; y < area.height; y += tileSize) {
+			for (int x = 0; x < area.width; x += tileSize) {
+				cv::Rect tile = cv::Rect(x, y, tileSize, tileSize) & cv::Rect(0, 0, area.width, area.height);
+				if (blendTile(tile, out))
+					writer.write(tile, out);
+				else
+					writer.write(tile, cv::Mat());
+			}
+		}
+	}
+
+private:
+	struct Input {
+		cv::Mat image;
+		panorama_detail::Placement placement;
+		/** Umgebendes Rechteck des projizierten Bildes in Leinwandkoordinaten */
+		cv::Rect rect;
+		/** Kanten des projizierten Vierecks (Leinwandkoordinaten) */
+		double edges[4][3];
+
+		Input(const cv::Mat &image, const cv::Mat_<double> &h, const cv::Rect &rect)
+			: image(image), placement(h, image.size()), rect(rect) {}
+	};
+
+	/**
+	 * Überblendet die Kachel tile nach out (Größe von tile); false, wenn kein
+	 * Bild das Fenster der Kachel berührt.
+	 */
+	bool blendTile(const cv::Rect &tile, cv::Mat &out) {
+		cv::Rect window(tile.x - margin, tile.y - margin, tileSize + 2 * margin, tileSize + 2 * margin);
+		std::vector<cv::Mat> band(levels + 1), weightSum(levels + 1);
+		bool any = false;
+
+		std::vector<cv::Mat> gauss(levels + 1), weight(levels + 1), coverage(levels + 1);
+		for (size_t i = 0; i < inputs.size(); ++i) {
+			const Input &input = inputs[i];
+			cv::Rect part = input.rect & window;
+			if (part.width <= 0 || part.height <= 0)
+				continue;
+			if (!any) {
+				for (int l = 0; l <= levels; ++l) {
+					cv::Size size(window.width >> l, window.height >> l);
+					band[l] = cv::Mat(size, type, cv::Scalar::all(0));
+					weightSum[l] = cv::Mat(size, CV_32FC1, cv::Scalar(0));
+				}
+				any = true;
+			}
+
+			// Bild, Überdeckung und Gewicht im Fenster, außerhalb null
+			gauss[0] = cv::Mat(window.size(), type, cv::Scalar::all(0));
+			coverage[0] = cv::Mat(window.size(), CV_32FC1, cv::Scalar(0));
+			weight[0] = cv::Mat(window.size(), CV_32FC1, cv::Scalar(0));
+			if (!place(input, part, window.tl(), gauss[0], coverage[0], weight[0]))
+				continue;
+
+			// Gauß-Pyramiden; Lücken per normierter Faltung gefüllt: G_l = pyr(I M) / pyr(M)
+			for (int l = 1; l <= levels; ++l) {
+				cv::pyrDown(gauss[l - 1], gauss[l]);
+				cv::pyrDown(coverage[l - 1], coverage[l]);
+				cv::pyrDown(weight[l - 1], weight[l]);
+			}
+			for (int l = 0; l <= levels; ++l)
+				fillFromCoverage(gauss[l], coverage[l]);
+
+			// Laplace-Stufen, mit den Gewichten aufsummiert
+			cv::Mat up;
+			for (int l = 0; l <= levels; ++l) {
+				if (l < levels) {
+					cv::pyrUp(gauss[l + 1], up, gauss[l].size());
+					cv::subtract(gauss[l], up, up);
+				} else {
+					up = gauss[l];
+				}
+				addWeighted(up, weight[l], band[l], weightSum[l]);
+			}
+		}
+		if (!any)
+			return false;
+
+		// pro Stufe normieren und von grob nach fein zusammensetzen
+		cv::Mat result;
+		for (int l = levels; l >= 0; --l) {
+			normalizeBand(band[l], weightSum[l]);
+			if (l == levels) {
+				result = band[l];
+			} else {
+				cv::Mat up;
+				cv::pyrUp(result, up, band[l].size());
+				cv::add(band[l], up, result);
+			}
+		}
+
+		// außerhalb aller Bilder bleibt die Leinwand leer
+		int cn = result.channels();
+		for (int y = 0; y < result.rows; ++y) {
+			float *r = result.ptr<float>(y);
+			const float *w = weightSum[0].ptr<float>(y);
+			for (int x = 0; x < result.cols; ++x) {
+				if (w[x] <= 0) {
+					for (int k = 0; k < cn; ++k)
+						r[x * cn + k] = 0;
+				}
+			}
+		}
+		result(cv::Rect(margin, margin, tile.width, tile.height)).copyTo(out);
+		return true;
+	}
+
+	/**
+	 * Warpt input über part (Leinwandkoordinaten) in die Fensterpuffer mit
+	 * linker oberer Ecke origin: Bildwerte, Überdeckung 1 und Gewicht auf den
+	 * überdeckten Spannen. false, wenn keine Spanne etwas überdeckt.
+	 */
+	bool place(const Input &input, const cv::Rect &part, cv::Point origin, cv::Mat &image, cv::Mat &coverage, cv::Mat &weight) {
+		input.placement.place(input.image, part + area.tl(), scratch, patch, spans, executor);
+		if (!panorama_detail::anyCovered(spans))
+			return false;
+		int cn = image.channels();
+		for (int y = 0; y < part.height; ++y) {
+			const WarpSpan &s = spans[y];
+			if (s.width() <= 0)
+				continue;
+			int wy = part.y - origin.y + y, wx = part.x - origin.x + s.begin;
+			const float *p = patch.ptr<float>(y) + s.begin * cn;
+			std::copy(p, p + s.width() * cn, image.ptr<float>(wy) + wx * cn);
+			std::fill(coverage.ptr<float>(wy) + wx, coverage.ptr<float>(wy) + wx + s.width(), 1.0f);
+			float *w = weight.ptr<float>(wy) + wx;
+			double cy = part.y + y;
+			for (int x = 0; x < s.width(); ++x) {
+				double cx = part.x + s.begin + x, distance = HUGE_VAL;
+				for (int i = 0; i < 4; ++i)
+					distance = std::min(distance, input.edges[i][0] * cx + input.edges[i][1] * cy + input.edges[i][2]);
+				w[x] = (float)(std::max(distance, 0.0) + 1);
+			}
+		}
+		return true;
+	}
+
+	/** image /= coverage, null wo nichts überdeckt ist */
+	static void fillFromCoverage(cv::Mat &image, const cv::Mat &coverage) {
+		int cn = image.channels();
+		for (int y = 0; y < image.rows; ++y) {
+			float *p = image.ptr<float>(y);
+			const float *c = coverage.ptr<float>(y);
+			for (int x = 0; x < image.cols; ++x) {
+				float inv = c[x] > 1e-6f ? 1.0f / c[x] : 0.0f;
+				for (int k = 0; k < cn; ++k)
+					p[x * cn + k] *= inv;
+			}
+		}
+	}
+
+	/** band += level * weight, weightSum += weight */
+	static void addWeighted(const cv::Mat &level, const cv::Mat &weight, cv::Mat &band, cv::Mat &weightSum) {
+		int cn = level.channels();
+		for (int y = 0; y < level.rows; ++y) {
+			const float *p = level.ptr<float>(y), *w = weight.ptr<float>(y);
+			float *b = band.ptr<float>(y), *s = weightSum.ptr<float>(y);
+			for (int x = 0; x < level.cols; ++x) {
+				if (w[x] <= 0)
+					continue;
+				for (int k = 0; k < cn; ++k)
+					b[x * cn + k] += p[x * cn + k] * w[x];
+				s[x] += w[x];
+			}
+		}
+	}
+
+	static void normalizeBand(cv::Mat &band, const cv::Mat &weightSum) {
+		int cn = band.channels();
+		for (int y = 0; y < band.rows; ++y) {
+			float *b = band.ptr<float>(y);
+			const float *s = weightSum.ptr<float>(y);
+			for (int x = 0; x < band.cols; ++x) {
+				float inv = s[x] > 1e-6f ? 1.0f / s[x] : 0.0f;
+				for (int k = 0; k < cn; ++k)
+					b[x * cn + k] *= inv;
+			}
+		}
+	}
+
+	cv::Rect area;
+	int type, levels, tileSize, margin;
+	RowBandExecutor *executor;
+	std::vector<Input> inputs;
+	/** Puffer für place(), wachsen nur bei Bedarf */
+	cv::Mat scratch, patch;
+	std::vector<WarpSpan> spans;
+};
+
+#endif
@@ -0,0 +1,234 @@
+/**
+ * Kantendetektion nach Canny auf 8-Bit-Grauwertbildern.
+ *
+ * Der Sobel-Gradient wird genau einmal berechnet (int16, Randwiederholung),
+ * im selben Durchlauf entsteht das Histogramm des Betrags |dx| + |dy|, aus dem
+ * bei Bedarf die Schwellen bestimmt werden. Ein zweiter Durchlauf über die
+ * gespeicherten Beträge liefert die einfachen Schwellwertbilder und die
+ * Kandidaten der Nicht-Maximum-Unterdrückung; die Hysterese verfolgt von den
+ * starken Kanten aus einen expliziten Stapel statt das Bild erneut
+ * abzusuchen. Alle Puffer gehören dem Detektor und werden bei gleicher
+ * Bildgröße wiederverwendet.
+ */
+
+#ifndef CANNY_H
+#define CANNY_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include <cv.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+class EdgeDetector {
+public:
+	/** größter möglicher Betrag |dx| + |dy| des Sobel-Operators auf 8 Bit */
+	static const int MAX_MAGNITUDE = 2 * 4 * 255;
+
+	/**
+	 * Automatische Schwellen: high ist das highQuantile-Quantil der
+	 * Gradientenbeträge, low = lowRatio * high.
+	 */
+	explicit EdgeDetector(double highQuantile = 0.7, double lowRatio = 0.4)
+		: highQuantile(highQuantile), lowRatio(lowRatio), low(0), high(0) {}
+
+	/**
+	 * Schwellwertbilder weak (Betrag > low), strong (Betrag > high) und das
+	 * Canny-Ergebnis edges, alle CV_8UC1 mit 0/255. Negative Schwellen werden
+	 * aus dem Histogramm bestimmt.
+	 */
+	void detect(const cv::Mat &gray, int lowThreshold, int highThreshold,
+			cv::Mat &weak, cv::Mat &strong, cv::Mat &edges) {
+		CV_Assert(gray.type() == CV_8UC1);
+		int width = gray.cols, height = gray.rows, stride = width + 2;
+		dx.create(gray.size(), CV_16SC1);
+		dy.create(gray.size(), CV_16SC1);
+		// Betrag und Markierungen mit einem Pixel Rand (0)
+		magnitude.resize((size_t)stride * (height + 2));
+		labels.resize(magnitude.size());
+		clearBorder(magnitude, width, height);
+		clearBorder(labels, width, height);
+		histogram.assign(MAX_MAGNITUDE + 1, 0);
+
+		for (int y = 0; y < height; ++y) {
+			short *m = &magnitude[(size_t)(y + 1) * stride + 1];
+			sobelRow(gray, y, dx.ptr<short>(y), dy.ptr<short>(y), m);
+			for (int x = 0; x < width; ++x)
+				++histogram[m[x]];
+		}
+
+		if (highThreshold < 0)
+			highThreshold = quantile(highQuantile, width * height);
+		if (lowThreshold < 0)
+			lowThreshold = (int)(lowRatio * highThreshold + 0.5);
+		low = std::min(lowThreshold, highThreshold);
+		high = std::max(lowThreshold, highThreshold);
+
+		weak.create(gray.size(), CV_8UC1);
+		strong.create(gray.size(), CV_8UC1);
+		edges.create(gray.size(), CV_8UC1);
+		stack.clear();
+		for (int y = 0; y < height; ++y) {
+			const short *m = &magnitude[(size_t)(y + 1) * stride + 1];
+			const short *gx = dx.ptr<short>(y), *gy = dy.ptr<short>(y);
+			uchar *l = &labels[(size_t)(y + 1) * stride + 1];
+			uchar *w = weak.ptr<uchar>(y), *s = strong.ptr<uchar>(y);
+			for (int x = 0; x < width; ++x) {
+				int v = m[x];
+				w[x] = v > low ? 255 : 0;
+				s[x] = v > high ? 255 : 0;
+				l[x] = NONE;
+				if (v > low && localMaximum(m + x, stride, gx[x], gy[x])) {
+					l[x] = v > high ? EDGE : CANDIDATE;
+					if (v > high)
+						stack.push_back(l + x);
+				}
+			}
+		}
+
+		// Hysterese: Kandidaten, die mit einer starken Kante verbunden sind
+		const int offsets[8] = { -stride - 1, -stride, -stride + 1, -1, 1, stride - 1, stride, stride + 1 };
+		while (!stack.empty()) {
+			uchar *p = stack.back();
+			stack.pop_back();
+			for (int i = 0; i < 8; ++i) {
+				uchar *q = p + offsets[i];
+				if (*q == CANDIDATE) {
+					*q = EDGE;
+					stack.push_back(q);
+				}
+			}
+		}
+
+		for (int y = 0; y < height; ++y) {
+			const uchar *l = &labels[(size_t)(y + 1) * stride + 1];
+			uchar *e = edges.ptr<uchar>(y);
+			for (int x = 0; x < width; ++x)
+				e[x] = l[x] == EDGE ? 255 : 0;
+		}
+	}
+
+	/**
+	 * Canny mit automatischen Schwellen, ohne Schwellwertbilder.
+	 */
+	void detect(const cv::Mat &gray, cv::Mat &edges) {
+		detect(gray, -1, -1, weakScratch, strongScratch, edges);
+	}
+
+	int lowThreshold() const { return low; }
+	int highThreshold() const { return high; }
+
+	/** Sobel-Ableitungen des letzten Bildes (CV_16SC1) */
+	const cv::Mat &gradientX() const { return dx; }
+	const cv::Mat &gradientY() const { return dy; }
+
+	/** |dx| + |dy| des letzten Bildes (CV_16SC1, Sicht auf den internen Puffer) */
+	cv::Mat gradientMagnitude() const {
+		int stride = dx.cols + 2;
+		return cv::Mat(dx.rows, dx.cols, CV_16SC1, const_cast<short *>(&magnitude[stride + 1]), stride * sizeof(short));
+	}
+
+private:
+	enum { NONE = 0, CANDIDATE = 1, EDGE = 2 };
+
+	template<typename T>
+	static void clearBorder(std::vector<T> &buffer, int width, int height) {
+		int stride = width + 2;
+		std::fill(buffer.begin(), buffer.begin() + stride, T(0));
+		std::fill(buffer.end() - stride, buffer.end(), T(0));
+		for (int y = 1; y <= height; ++y) {
+			buffer[(size_t)y * stride] = 0;
+			buffer[(size_t)y * stride + width + 1] = 0;
+		}
+	}
+
+	/**
+	 * Sobel 3x3 für Zeile y mit Randwiederholung, dazu |dx| + |dy|.
+	 */
+	static void sobelRow(const cv::Mat &gray, int y, short *gx, short *gy, short *m) {
+		int width = gray.cols;
+		const uchar *up = gray.ptr<uchar>(std::max(y - 1, 0));
+		const uchar *mid = gray.ptr<uchar>(y);
+		const uchar *down = gray.ptr<uchar>(std::min(y + 1, gray.rows - 1));
+		sobelPixel(up, mid, down, 0, width, gx, gy, m);
+		int x = 1;
+#if defined(__SSE2__)
+		__m128i zero = _mm_setzero_si128();
+		for (; x + 9 <= width; x += 8) {
+			__m128i ul = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(up + x - 1)), zero);
+			__m128i uc = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(up + x)), zero);
+			__m128i ur = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(up + x + 1)), zero);
+			__m128i ml = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(mid + x - 1)), zero);
+			__m128i mr = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(mid + x + 1)), zero);
+			__m128i dl = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(down + x - 1)), zero);
+			__m128i dc = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(down + x)), zero);
+			__m128i dr = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(down + x + 1)), zero);
+
+			__m128i vx = _mm_add_epi16(_mm_sub_epi16(ur, ul), _mm_sub_epi16(dr, dl));
+			vx = _mm_add_epi16(vx, _mm_slli_epi16(_mm_sub_epi16(mr, ml), 1));
+			__m128i vy = _mm_sub_epi16(_mm_add_epi16(dl, dr), _mm_add_epi16(ul, ur));
+			vy = _mm_add_epi16(vy, _mm_slli_epi16(_mm_sub_epi16(dc, uc), 1));
+			__m128i ax = _mm_max_epi16(vx, _mm_sub_epi16(zero, vx));
+			__m128i ay = _mm_max_epi16(vy, _mm_sub_epi16(zero, vy));
+
+			_mm_storeu_si128((__m128i *)(gx + x), vx);
+			_mm_storeu_si128((__m128i *)(gy + x), vy);
+			_mm_storeu_si128((__m128i *)(m + x), _mm_add_epi16(ax, ay));
+		}
+#endif
+		for (; x < width; ++x)
+			sobelPixel(up, mid, down, x, width, gx, gy, m);
+	}
+
+	static void sobelPixel(const uchar *up, const uchar *mid, const uchar *down, int x, int width,
+			short *gx, short *gy, short *m) {
+		int l = x > 0 ? x - 1 : 0, r = x < width - 1 ? x + 1 : width - 1;
+		int vx = (up[r] - up[l]) + 2 * (mid[r] - mid[l]) + (down[r] - down[l]);
+		int vy = (down[l] + 2 * down[x] + down[r]) - (up[l] + 2 * up[x] + up[r]);
+		gx[x] = (short)vx;
+		gy[x] = (short)vy;
+		m[x] = (short)(std::abs(vx) + std::abs(vy));
+	}
+
+	/**
+	 * Maximum entlang der Gradientenrichtung, quantisiert auf 0, 45, 90 und
+	 * 135 Grad (wie cvCanny: > auf der einen, >= auf der anderen Seite).
+	 */
+	static bool localMaximum(const short *m, int stride, int gx, int gy) {
+		// tan(22.5) und tan(67.5) in Q15
+		const int TG22 = 13573, TG67 = 79109;
+		int v = *m, ax = std::abs(gx), ay = std::abs(gy) << 15;
+		if (ay < TG22 * ax)
+			return v > m[-1] && v >= m[1];
+		if (ay > TG67 * ax)
+			return v > m[-stride] && v >= m[stride];
+		int s = (gx ^ gy) < 0 ? -1 : 1;
+		return v > m[-stride - s] && v > m[stride + s];
+	}
+
+	/**
+	 * Kleinster Betrag, unter dem mindestens der Anteil q aller Pixel liegt.
+	 */
+	int quantile(double q, int pixels) const {
+		long long target = (long long)(q * pixels), count = 0;
+		for (int i = 0; i <= MAX_MAGNITUDE; ++i) {
+			count += histogram[i];
+			if (count > target)
+				return std::max(i, 1);
+		}
+		return MAX_MAGNITUDE;
+	}
+
+	double highQuantile, lowRatio;
+	int low, high;
+	cv::Mat dx, dy, weakScratch, strongScratch;
+	std::vector<short> magnitude;
+	std::vector<uchar> labels;
+	std::vector<int> histogram;
+	std::vector<uchar *> stack;
+};
+
+#endif
@@ -0,0 +1,169 @@
+/**
+ * Wiederverwendbare Bildpuffer für Verarbeitungsketten, die pro Bild viele
+ * Zwischenergebnisse gleicher Größe brauchen.
+ *
+ * Puffer werden nach (Breite, Höhe, Typ) geschlüsselt vorgehalten, Zeilen
+ * beginnen auf 64-Byte-Grenzen. acquire() liefert einen freien Puffer oder
+ * legt einen neuen an, release() bzw. recycle() geben Puffer an den Pool
+ * zurück. Nach dem ersten Bild einer Folge gleicher Größe finden daher keine
+ * Allokationen mehr statt. Der Pool gibt beim Zerstören alle Puffer frei.
+ */
+
+#ifndef IMAGEPOOL_H
+#define IMAGEPOOL_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include <cv.h>
+
+struct ImagePoolStats {
+	/** Anzahl der Pufferallokationen seit Erzeugung des Pools */
+	size_t allocations;
+	/** vom Pool gehaltener Speicher (freie und verliehene Puffer) */
+	size_t reservedBytes;
+	size_t inUseBytes;
+	size_t peakInUseBytes;
+
+	ImagePoolStats() : allocations(0), reservedBytes(0), inUseBytes(0), peakInUseBytes(0) {}
+};
+
+class ImagePool {
+public:
+	static const size_t ALIGNMENT = 64;
+
+	ImagePool() {}
+
+	~ImagePool() {
+		for (size_t i = 0; i < buffers.size(); ++i) {
+			free(buffers[i]->data);
+			delete buffers[i];
+		}
+	}
+
+	/**
+	 * Bild der Größe size und des Typs type (z.B. CV_32FC1). Der Inhalt ist
+	 * undefiniert; die Matrix verweist auf Speicher des Pools und bleibt bis
+	 * zum release() bzw. recycle() gültig.
+	 */
+	cv::Mat acquire(cv::Size size, int type) {
+		Buffer *buffer = take(size, type);
+		return cv::Mat(size, type, buffer->data, buffer->step);
+	}
+
+	/**
+	 * Wie acquire(), für Code mit der C-Schnittstelle.
+	 */
+	IplImage *acquireImage(CvSize size, int depth, int channels) {
+		Buffer *buffer = take(cv::Size(size.width, size.height), CV_MAKETYPE(matDepth(depth), channels));
+		if (!buffer->hasHeader) {
+			cvInitImageHeader(&buffer->header, size, depth, channels);
+			cvSetData(&buffer->header, buffer->data, (int)buffer->step);
+			buffer->hasHeader = true;
+		}
+		return &buffer->header;
+	}
+
+	void release(const cv::Mat &image) {
+		give(image.data);
+	}
+
+	void release(const IplImage *image) {
+		give(image->imageData);
+	}
+
+	/**
+	 * Gibt alle verliehenen Puffer zurück, typischerweise am Ende eines Bildes.
+	 */
+	void recycle() {
+		for (size_t i = 0; i < buffers.size(); ++i) {
+			if (buffers[i]->inUse)
+				give(buffers[i]->data);
+		}
+	}
+
+	const ImagePoolStats &stats() const { return statistics; }
+
+private:
+	struct Key {
+		int width, height, type;
+
+		bool operator<(const Key &other) const {
+			if (width != other.width)
+				return width < other.width;
+			if (height != other.height)
+				return height < other.height;
+			return type < other.type;
+		}
+	};
+
+	struct Buffer {
+		Key key;
+		void *data;
+		size_t step, bytes;
+		bool inUse, hasHeader;
+		IplImage header;
+	};
+
+	ImagePool(const ImagePool &);
+	ImagePool &operator=(const ImagePool &);
+
+	static int matDepth(int iplDepth) {
+		// IPL_DEPTH_SIGN liegt außerhalb von int, daher keine switch-Anweisung
+		const int ipl[] = { IPL_DEPTH_8U, (int)IPL_DEPTH_8S, IPL_DEPTH_16U, (int)IPL_DEPTH_16S,
+		                    (int)IPL_DEPTH_32S, IPL_DEPTH_32F, IPL_DEPTH_64F };
+		const int mat[] = { CV_8U, CV_8S, CV_16U, CV_16S, CV_32S, CV_32F, CV_64F };
+		for (int i = 0; i < 7; ++i) {
+			if (ipl[i] == iplDepth)
+				return mat[i];
+		}
+		CV_Error(CV_StsUnsupportedFormat, "unsupported IPL depth");
+		return -1;
+	}
+
+	Buffer *take(cv::Size size, int type) {
+		Key key = { size.width, size.height, type };
+		std::vector<Buffer *> &list = available[key];
+		Buffer *buffer;
+		if (!list.empty()) {
+			buffer = list.back();
+			list.pop_back();
+		} else {
+			buffer = new Buffer();
+			buffer->key = key;
+			size_t row = (size_t)size.width * CV_ELEM_SIZE(type);
+			buffer->step = (row + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+			buffer->bytes = buffer->step * size.height;
+			buffer->hasHeader = false;
+			if (posix_memalign(&buffer->data, ALIGNMENT, std::max(buffer->bytes, (size_t)1)) != 0) {
+				delete buffer;
+				CV_Error(CV_StsNoMem, "image pool allocation failed");
+			}
+			buffers.push_back(buffer);
+			byData[buffer->data] = buffer;
+			++statistics.allocations;
+			statistics.reservedBytes += buffer->bytes;
+		}
+		buffer->inUse = true;
+		statistics.inUseBytes += buffer->bytes;
+		statistics.peakInUseBytes = std::max(statistics.peakInUseBytes, statistics.inUseBytes);
+		return buffer;
+	}
+
+	void give(const void *data) {
+		std::map<const void *, Buffer *>::iterator it = byData.find(data);
+		CV_Assert(it != byData.end() && it->second->inUse);
+		Buffer *buffer = it->second;
+		buffer->inUse = false;
+		statistics.inUseBytes -= buffer->bytes;
+		available[buffer->key].push_back(buffer);
+	}
+
+	std::vector<Buffer *> buffers;
+	std::map<Key, std::vector<Buffer *> > available;
+	std::map<const void *, Buffer *> byData;
+	ImagePoolStats statistics;
+};
+
+#endif
@@ -0,0 +1,215 @@
+/**
+ * Nicht-Maximum-Unterdrückung auf float-Antwortbildern.
+ *
+ * Ein Pixel ist ein Maximum, wenn es über der Schwelle liegt, größer als alle
+ * Nachbarn im (2 radius + 1)^2-Fenster vor ihm (in Zeilenreihenfolge) und
+ * mindestens so groß wie alle nach ihm ist. Bei gleichen Werten (etwa
+ * ganzzahligen Stimmen) bleibt so genau ein Maximum übrig, wie bei
+ * HoughAccumulator::peaks. Gearbeitet wird
+ * zeilenweise auf Zeigern in die Zeilen y - radius .. y + radius, so dass die
+ * Unterdrückung auch in Verfahren eingebaut werden kann, die ihr Antwortbild
+ * nur als Ringpuffer halten. Die Vergleiche laufen über 4 Pixel gleichzeitig
+ * und brechen ab, sobald keines davon mehr Maximum sein kann.
+ */
+
+#ifndef NMS_H
+#define NMS_H
+
+#include <algorithm>
+#include <vector>
+#include <cv.h>
+
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#endif
+
+struct Peak {
+	cv::Point pt;
+	float response;
+
+	Peak() : response(0) {}
+	Peak(int x, int y, float response) : pt(x, y), response(response) {}
+};
+
+/**
+ * Ordnung nach Antwort, bei Gleichstand nach Position, damit die Auswahl
+ * deterministisch ist.
+ */
+inline bool strongerPeak(const Peak &a, const Peak &b) {
+	if (a.response != b.response)
+		return a.response > b.response;
+	return a.pt.y != b.pt.y ? a.pt.y < b.pt.y : a.pt.x < b.pt.x;
+}
+
+/**
+ * Auswahl der Maxima: maxPeaks = 0 liefert alle. Mit cellSize > 0 und
+ * maxPerCell > 0 werden pro Gitterzelle cellSize x cellSize höchstens
+ * maxPerCell Maxima behalten, so dass sich die Punkte über das Bild verteilen.
+ */
+struct PeakSelection {
+	int radius;
+	int maxPeaks;
+	int cellSize, maxPerCell;
+
+	explicit PeakSelection(int radius = 1, int maxPeaks = 0, int cellSize = 0, int maxPerCell = 0)
+		: radius(radius), maxPeaks(maxPeaks), cellSize(cellSize), maxPerCell(maxPerCell) {}
+};
+
+/**
+ * Sammelt Maxima gemäß einer PeakSelection. Begrenzte Auswahlen werden als
+ * Min-Heaps fester Größe gehalten, der Speicherbedarf hängt dann nicht von der
+ * Anzahl der Kandidaten ab. Mit reset() lässt sich ein Sammler für das
+ * nächste Bild wiederverwenden, ohne neuen Speicher anzulegen.
+ */
+class PeakCollector {
+public:
+	PeakCollector() : cellsX(0) {}
+
+	PeakCollector(cv::Size size, const PeakSelection &selection) : cellsX(0) {
+		reset(size, selection);
+	}
+
+	/** Leert den Sammler für ein Bild der Größe size; Kapazitäten bleiben erhalten */
+	void reset(cv::Size size, const PeakSelection &selection) {
+		this->selection = selection;
+		cellsX = 0;
+		peaks.clear();
+		if (selection.cellSize > 0 && selection.maxPerCell > 0) {
+			cellsX = (size.width + selection.cellSize - 1) / selection.cellSize;
+			int cellsY = (size.height + selection.cellSize - 1) / selection.cellSize;
+			cells.resize(cellsX * cellsY);
+			for (size_t i = 0; i < cells.size(); ++i)
+				cells[i].clear();
+		} else if (selection.maxPeaks > 0) {
+			peaks.reserve(selection.maxPeaks);
+		}
+	}
+
+	void add(int x, int y, float response) {
+		Peak peak(x, y, response);
+		if (cellsX > 0)
+			offer(cells[(y / selection.cellSize) * cellsX + x / selection.cellSize], selection.maxPerCell, peak);
+		else if (selection.maxPeaks > 0)
+			offer(peaks, selection.maxPeaks, peak);
+		else
+			peaks.push_back(peak);
+	}
+
+	/**
+	 * Ergebnis; bei begrenzter Auswahl absteigend nach Antwort sortiert, sonst
+	 * in Zeilenreihenfolge.
+	 */
+	std::vector<Peak> result() const {
+		std::vector<Peak> out;
+		result(out);
+		return out;
+	}
+
+	/** Wie result(), schreibt aber in out und nutzt dessen Kapazität */
+	void result(std::vector<Peak> &out) const {
+		out.clear();
+		if (cellsX > 0) {
+			for (size_t i = 0; i < cells.size(); ++i)
+				out.insert(out.end(), cells[i].begin(), cells[i].end());
+		} else {
+			out.assign(peaks.begin(), peaks.end());
+		}
+		if (cellsX > 0 || selection.maxPeaks > 0) {
+			size_t keep = selection.maxPeaks > 0 ? std::min(out.size(), (size_t)selection.maxPeaks) : out.size();
+			std::partial_sort(out.begin(), out.begin() + keep, out.end(), strongerPeak);
+			out.resize(keep);
+		}
+	}
+
+private:
+	static void offer(std::vector<Peak> &heap, int capacity, const Peak &peak) {
+		// strongerPeak als Vergleich: die Wurzel ist das schwächste Element
+		if ((int)heap.size() < capacity) {
+			heap.push_back(peak);
+			std::push_heap(heap.begin(), heap.end(), strongerPeak);
+		} else if (strongerPeak(peak, heap.front())) {
+			std::pop_heap(heap.begin(), heap.end(), strongerPeak);
+			heap.back() = peak;
+			std::push_heap(heap.begin(), heap.end(), strongerPeak);
+		}
+	}
+
+	PeakSelection selection;
+	int cellsX;
+	std::vector<Peak> peaks;
+	std::vector<std::vector<Peak> > cells;
+};
+
+/**
+ * Unterdrückung für Zeile y. rows zeigt auf den Zeiger der Zeile y, gültig sind
+ * rows[-radius] .. rows[radius]. Geprüft werden die Spalten
+ * [radius, width - radius).
+ */
+inline void suppressRow(const float *const *rows, int width, int y, int radius, float threshold, PeakCollector &out) {
+	const float *row = rows[0];
+	int x = radius;
+#if defined(__SSE2__)
+	__m128 t = _mm_set1_ps(threshold);
+	for (; x + 4 <= width - radius; x += 4) {
+		__m128 v = _mm_loadu_ps(row + x);
+		int mask = _mm_movemask_ps(_mm_cmpgt_ps(v, t));
+		for (int i = -radius; i <= radius && mask; ++i) {
+			const float *r = rows[i] + x;
+			if (i == 0) {
+				// links davor: strikt, rechts danach: Gleichstand erlaubt
+				__m128 before = _mm_loadu_ps(r - radius), after = _mm_loadu_ps(r + radius);
+				for (int j = 1; j < radius; ++j) {
+					before = _mm_max_ps(before, _mm_loadu_ps(r - j));
+					after = _mm_max_ps(after, _mm_loadu_ps(r + j));
+				}
+				mask &= _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(v, before), _mm_cmpge_ps(v, after)));
+				continue;
+			}
+			__m128 m = _mm_loadu_ps(r - radius);
+			for (int j = -radius + 1; j <= radius; ++j)
+				m = _mm_max_ps(m, _mm_loadu_ps(r + j));
+			mask &= _mm_movemask_ps(i < 0 ? _mm_cmpgt_ps(v, m) : _mm_cmpge_ps(v, m));
+		}
+		for (; mask; mask &= mask - 1) {
+			int k = __builtin_ctz(mask);
+			out.add(x + k, y, row[x + k]);
+		}
+	}
+#endif
+	for (; x < width - radius; ++x) {
+		float v = row[x];
+		bool maximum = v > threshold;
+		for (int i = -radius; i <= radius && maximum; ++i) {
+			for (int j = -radius; j <= radius; ++j) {
+				if (i == 0 && j == 0)
+					continue;
+				bool before = i < 0 || (i == 0 && j < 0);
+				if (before ? !(v > rows[i][x + j]) : !(v >= rows[i][x + j])) {
+					maximum = false;
+					break;
+				}
+			}
+		}
+		if (maximum)
+			out.add(x, y, v);
+	}
+}
+
+/**
+ * Maxima eines ganzen Antwortbildes (CV_32FC1).
+ */
+inline std::vector<Peak> nonMaxSuppression(const cv::Mat &response, float threshold,
+		const PeakSelection &selection = PeakSelection()) {
+	CV_Assert(response.type() == CV_32FC1 && selection.radius >= 1);
+	int radius = selection.radius;
+	PeakCollector collector(response.size(), selection);
+	std::vector<const float *> rows(2 * radius + 1);
+	for (int y = radius; y < response.rows - radius; ++y) {
+		for (int i = -radius; i <= radius; ++i)
+			rows[i + radius] = response.ptr<float>(y + i);
+		suppressRow(&rows[radius], response.cols, y, radius, threshold, collector);
+	}
+	return collector.result();
+}
+
+#endif
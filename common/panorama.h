@@ -0,0 +1,210 @@
+/**
+ * Panoramen auf einer gemeinsamen Leinwand zusammensetzen.
+ *
+ * Jedes Bild wird mit PerspectiveWarp nur über die Pixel seines projizierten
+ * Vierecks gewarpt und direkt in den entsprechenden Ausschnitt (ROI) der
+ * Leinwand aufsummiert; Bilder, die nur ganzzahlig verschoben werden, werden
+ * ohne Warp übernommen. Die Leinwand hält die Summe (CV_32FC(n)) und die
+ * Anzahl der Beiträge pro Pixel (CV_16UC1), result() teilt einmal am Ende in
+ * place.
+ * Außer diesen beiden Puffern und einem wiederverwendeten Puffer in der Größe
+ * des größten Ausschnitts wird kein Speicher in Leinwandgröße angelegt.
+ */
+
+#ifndef PANORAMA_H
+#define PANORAMA_H
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <vector>
+#include <cv.h>
+
+#include "warp.h"
+
+/**
+ * Kleinstes Rechteck (halboffen, in Pixeln der Zielebene), das die
+ * Pixelmittelpunkte der Ecken eines Bildes der Größe size unter der
+ * Homographie H (3x3, Bild → Zielebene) enthält.
+ */
+inline cv::Rect projectedBounds(const cv::Mat &H, cv::Size size) {
+	cv::Mat_<double> h;
+	H.convertTo(h, CV_64F);
+	CV_Assert(h.rows == 3 && h.cols == 3);
+	double corners[4][2] = { { 0, 0 }, { size.width - 1.0, 0 }, { size.width - 1.0, size.height - 1.0 }, { 0, size.height - 1.0 } };
+	double x0 = HUGE_VAL, y0 = HUGE_VAL, x1 = -HUGE_VAL, y1 = -HUGE_VAL;
+	for (int i = 0; i < 4; ++i) {
+		double x = corners[i][0], y = corners[i][1];
+		double w = h(2, 0) * x + h(2, 1) * y + h(2, 2);
+		// alle Ecken müssen vor der Kamera liegen
+		CV_Assert(w > 0);
+		double u = (h(0, 0) * x + h(0, 1) * y + h(0, 2)) / w;
+		double v = (h(1, 0) * x + h(1, 1) * y + h(1, 2)) / w;
+		x0 = std::min(x0, u); x1 = std::max(x1, u);
+		y0 = std::min(y0, v); y1 = std::max(y1, v);
+	}
+	int left = (int)std::floor(x0), top = (int)std::floor(y0);
+	return cv::Rect(left, top, (int)std::floor(x1) + 1 - left, (int)std::floor(y1) + 1 - top);
+}
+
+namespace panorama_detail {
+
+inline bool integerShift(const cv::Mat_<double> &h, cv::Point &shift) {
+	double s = h(2, 2);
+	if (h(2, 0) != 0 || h(2, 1) != 0 || s == 0 || h(0, 0) != s || h(1, 1) != s || h(0, 1) != 0 || h(1, 0) != 0)
+		return false;
+	double dx = h(0, 2) / s, dy = h(1, 2) / s;
+	shift = cv::Point(cvRound(dx), cvRound(dy));
+	return dx == shift.x && dy == shift.y;
+}
+
+/**
+ * Lage eines Bildes in der Zielebene: ganzzahlige Verschiebung oder
+ * perspektivischer Warp.
+ */
+class Placement {
+public:
+	Placement(const cv::Mat_<double> &h, cv::Size size) : shifted(integerShift(h, shift)), warp(h, size) {}
+
+	/**
+	 * Werte des Bildes image im Rechteck rect der Zielebene nach patch, die
+	 * überdeckten Spalten jeder Zeile nach spans. Bei einer Verschiebung ist
+	 * patch ein Ausschnitt von image selbst (rect muss dann im Bild liegen),
+	 * sonst ein Ausschnitt von scratch, der nur bei Bedarf wächst.
+	 */
+	void place(const cv::Mat &image, const cv::Rect &rect, cv::Mat &scratch, cv::Mat &patch, std::vector<WarpSpan> &spans,
+			RowBandExecutor *executor) const {
+		if (shifted) {
+			patch = image(rect - shift);
+			spans.assign(rect.height, WarpSpan(0, rect.width));
+			return;
+		}
+		if (scratch.rows < rect.height || scratch.cols < rect.width || scratch.type() != image.type())
+			scratch.create(std::max(scratch.rows, rect.height), std::max(scratch.cols, rect.width), image.type());
+		patch = scratch(cv::Rect(0, 0, rect.width, rect.height));
+		warp.warp(image, rect, patch, spans, executor);
+	}
+
+private:
+	cv::Point shift;
+	bool shifted;
+	PerspectiveWarp warp;
+};
+
+/** Überdeckt mindestens eine Spanne ein Pixel? */
+inline bool anyCovered(const std::vector<WarpSpan> &spans) {
+	for (size_t y = 0; y < spans.size(); ++y) {
+		if (spans[y].width() > 0)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Summiert die Spannen von patch in sum (gleiche Größe und Typ) auf und zählt
+ * die Beiträge in count (CV_16UC1, höchstens 65535, auch ohne Debug geprüft).
+ * Liefert die Anzahl der Pixel.
+ */
+inline size_t accumulate(const cv::Mat &patch, const std::vector<WarpSpan> &spans, cv::Mat sum, cv::Mat count) {
+	int cn = patch.channels();
+	size_t pixels = 0;
+	for (int y = 0; y < patch.rows; ++y) {
+		const float *p = patch.ptr<float>(y);
+		float *s = sum.ptr<float>(y);
+		ushort *c = count.ptr<ushort>(y);
+		for (int x = spans[y].begin; x < spans[y].end; ++x) {
+			CV_Assert(c[x] < USHRT_MAX);
+			for (int k = 0; k < cn; ++k)
+				s[x * cn + k] += p[x * cn + k];
+			++c[x];
+		}
+		pixels += spans[y].width();
+	}
+	return pixels;
+}
+
+/** Teilt sum durch count, wo mehr als ein Beitrag vorliegt */
+inline void normalize(cv::Mat sum, const cv::Mat &count) {
+	int cn = sum.channels();
+	for (int y = 0; y < sum.rows; ++y) {
+		float *s = sum.ptr<float>(y);
+		const ushort *c = count.ptr<ushort>(y);
+		for (int x = 0; x < sum.cols; ++x, s += cn) {
+			if (c[x] > 1) {
+				float inv = 1.0f / c[x];
+				for (int k = 0; k < cn; ++k)
+					s[k] *= inv;
+			}
+		}
+	}
+}
+
+}
+
+class PanoramaCanvas {
+public:
+	/**
+	 * Leinwand über area (Koordinaten der Zielebene) vom Typ CV_32FC(n),
+	 * anfangs leer. Mit executor werden die Zeilen eines Bildes parallel
+	 * gewarpt.
+	 */
+	explicit PanoramaCanvas(const cv::Rect &area, int type = CV_32FC1, RowBandExecutor *executor = 0)
+		: area(area), sum(area.size(), type, cv::Scalar::all(0)), count(area.size(), CV_16UC1, cv::Scalar(0)),
+		  executor(executor), written(0), normalized(false) {
+		CV_Assert(CV_MAT_DEPTH(type) == CV_32F);
+	}
+
+	const cv::Rect &bounds() const { return area; }
+
+	/** Summe der Beiträge, nach result() der Mittelwert */
+	const cv::Mat &image() const { return sum; }
+
+	/** Anzahl der Beiträge pro Pixel */
+	const cv::Mat &coverage() const { return count; }
+
+	/** Summe der von allen Bildern beschriebenen Pixel */
+	size_t pixelsWritten() const { return written; }
+
+	/**
+	 * Fügt image (Typ der Leinwand, Werte >= 0) mit der Homographie H (Bild →
+	 * Zielebene) hinzu und liefert den beschriebenen Ausschnitt in
+	 * Leinwandkoordinaten. Pixel, deren bilineare Interpolation auch nur
+	 * teilweise außerhalb des Bildes liegt, tragen nicht bei. Höchstens 65535
+	 * Beiträge pro Pixel.
+	 */
+	cv::Rect add(const cv::Mat &image, const cv::Mat &H) {
+		CV_Assert(image.type() == sum.type() && !normalized);
+		cv::Mat_<double> h;
+		H.convertTo(h, CV_64F);
+		cv::Rect roi = projectedBounds(h, image.size()) & area;
+		if (roi.width <= 0 || roi.height <= 0)
+			return cv::Rect();
+		cv::Mat patch;
+		panorama_detail::Placement(h, image.size()).place(image, roi, scratch, patch, spans, executor);
+		roi -= area.tl();
+		written += panorama_detail::accumulate(patch, spans, sum(roi), count(roi));
+		return roi;
+	}
+
+	/**
+	 * Mittelwert aller Beiträge; danach können keine Bilder mehr hinzugefügt
+	 * werden. Der Rückgabewert teilt den Speicher mit der Leinwand.
+	 */
+	const cv::Mat &result() {
+		if (!normalized) {
+			panorama_detail::normalize(sum, count);
+			normalized = true;
+		}
+		return sum;
+	}
+
+private:
+	cv::Rect area;
+	cv::Mat sum, count, scratch;
+	std::vector<WarpSpan> spans;
+	RowBandExecutor *executor;
+	size_t written;
+	bool normalized;
+};
+
+#endif
@@ -0,0 +1,299 @@
+/**
+ * Panoramen aus vielen Bildern: Graph der paarweisen Homographien.
+ *
+ * Registriert werden nicht alle N² Paare, sondern für jedes neue Bild nur
+ * wenige Kandidaten: die direkten Vorgänger in der Aufnahmereihenfolge und die
+ * Bilder, in denen die meisten Deskriptoren seiner Signatur (eine kleine
+ * Auswahl seiner Merkmale) den Verhältnistest bestehen. Der Test läuft pro
+ * Bild, damit ein Ort, der in mehreren Bildern vorkommt (Schleife), nicht
+ * an sich selbst scheitert. Die Signaturen kosten
+ * pro neuem Bild nur einen Vergleich mit den Signaturen aller bisherigen
+ * Bilder; die teure Registrierung (Matching aller Merkmale, RANSAC) läuft nur
+ * für die Kandidaten.
+ *
+ * Jede erfolgreiche Registrierung ist eine Kante mit der Anzahl ihrer Inlier
+ * als Gewicht. Die Bilder werden über einen Spannbaum maximalen Gewichts
+ * (Prim) an das erste Bild, die Referenz, gehängt; ihre Homographie zur
+ * Referenz ist das Produkt der Kanten entlang des Baums. Ein neues Bild wird
+ * über seine beste Kante eingehängt, ohne schon platzierte Bilder zu
+ * verändern; verbindet es bisher getrennte Teile, werden diese von ihm aus
+ * angehängt. rebuild() berechnet den Baum über alle Kanten neu.
+ */
+
+#ifndef PANORAMAGRAPH_H
+#define PANORAMAGRAPH_H
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+#include <cv.h>
+
+#include "panorama.h"
+
+/** Registriertes Bildpaar */
+struct PanoramaEdge {
+	int from, to;
+	/** Homographie from → to */
+	cv::Mat H;
+	int inliers;
+};
+
+class PanoramaGraph {
+public:
+	/**
+	 * Schätzt die Homographie H von Bild from nach Bild to und die Anzahl
+	 * ihrer Inlier; false, wenn die Bilder nicht zusammenpassen.
+	 */
+	typedef std::function<bool(int from, int to, cv::Mat &H, int &inliers)> Registration;
+
+	/**
+	 * Pro neuem Bild werden die neighbours Vorgänger und bis zu candidates
+	 * weitere Bilder registriert; Kanten mit weniger als minInliers Inliern
+	 * werden verworfen. ratio ist der Verhältnistest der Signaturen innerhalb
+	 * eines Bildes (auf quadrierten Abständen wie matchDescriptors()).
+	 */
+	explicit PanoramaGraph(const Registration &registration, int candidates = 4, int neighbours = 1, int minInliers = 12,
+			float ratio = 0.6f)
+		: registration(registration), candidates(candidates), neighbours(neighbours), minInliers(minInliers), ratio(ratio),
+		  registered(0), placedFrames(0) {
+		CV_Assert(candidates >= 0 && neighbours >= 0);
+	}
+
+	/**
+	 * Hängt ein Bild der Größe size an und liefert seinen Index.
+	 * signature enthält eine Auswahl seiner Deskriptoren (CV_32FC1, einer pro
+	 * Zeile, bei allen Bildern gleich lang; darf leer sein).
+	 */
+	int append(cv::Size size, const cv::Mat &signature) {
+		CV_Assert(signature.empty() || signature.type() == CV_32FC1);
+		int index = (int)frames.size();
+		Frame frame;
+		frame.size = size;
+		frame.signature = signature;
+		frames.push_back(frame);
+
+		std::vector<int> pairs = candidateFrames(index);
+		for (size_t i = 0; i < pairs.size(); ++i) {
+			PanoramaEdge edge;
+			edge.from = index;
+			edge.to = pairs[i];
+			edge.inliers = 0;
+			++registered;
+			if (!registration(edge.from, edge.to, edge.H, edge.inliers) || edge.inliers < minInliers)
+				continue;
+			frames[edge.from].edges.push_back((int)edges.size());
+			frames[edge.to].edges.push_back((int)edges.size());
+			edges.push_back(edge);
+		}
+
+		if (index == 0)
+			place(0, -1, cv::Mat::eye(3, 3, CV_64F));
+		else
+			grow(index);
+		return index;
+	}
+
+	/**
+	 * Spannbaum maximalen Gewichts über alle bisherigen Kanten neu aufbauen.
+	 * Danach können sich alle Homographien ändern; schon gezeichnete Bilder
+	 * müssen neu gezeichnet werden.
+	 */
+	void rebuild() {
+		for (size_t i = 0; i < frames.size(); ++i) {
+			frames[i].placed = false;
+			frames[i].parent = -1;
+			frames[i].transform.release();
+		}
+		area = cv::Rect();
+		placedFrames = 0;
+		if (!frames.empty()) {
+			place(0, -1, cv::Mat::eye(3, 3, CV_64F));
+			grow(0);
+		}
+	}
+
+	int size() const { return (int)frames.size(); }
+
+	cv::Size frameSize(int i) const { return frames[i].size; }
+
+	/** Hängt Bild i am Baum der Referenz? */
+	bool placed(int i) const { return frames[i].placed; }
+
+	int placedCount() const { return placedFrames; }
+
+	/** Homographie Bild i → Referenz (CV_64FC1), leer, solange nicht platziert */
+	const cv::Mat &transform(int i) const { return frames[i].transform; }
+
+	/** Vorgänger im Baum, -1 für die Referenz und nicht platzierte Bilder */
+	int parent(int i) const { return frames[i].parent; }
+
+	const std::vector<PanoramaEdge> &pairs() const { return edges; }
+
+	/** Anzahl der bisher versuchten Registrierungen */
+	size_t registrations() const { return registered; }
+
+	/** Umgebendes Rechteck aller platzierten Bilder in der Ebene der Referenz */
+	const cv::Rect &bounds() const { return area; }
+
+private:
+	struct Frame {
+		cv::Size size;
+		cv::Mat signature, transform;
+		/** Indizes der Kanten */
+		std::vector<int> edges;
+		int parent;
+		bool placed;
+
+		Frame() : parent(-1), placed(false) {}
+	};
+
+	/**
+	 * Vorgänger und die Bilder mit den meisten Stimmen der Signatur, ohne
+	 * Doppelte. Ein globaler Verhältnistest würde gerade Schleifenschlüsse
+	 * verwerfen: zeigt ein Ort in mehreren Bildern, ist der zweitbeste Treffer
+	 * derselbe Ort in einem anderen Bild. Der Test läuft daher pro Bild: Ein
+	 * Deskriptor stimmt für alle Bilder, deren bester Treffer höchstens um
+	 * 1 / ratio weiter entfernt ist als der beste aller Bilder, sofern dieser
+	 * den Verhältnistest gegen den zweitbesten Treffer innerhalb jedes dieser
+	 * Bilder besteht.
+	 */
+	std::vector<int> candidateFrames(int index) const {
+		std::vector<int> result;
+		for (int i = index - 1; i >= 0 && i >= index - neighbours; --i)
+			result.push_back(i);
+
+		std::vector<int> votes(index, 0);
+		const cv::Mat &query = frames[index].signature;
+		std::vector<float> bestDist(index), secondBestDist(index);
+		for (int q = 0; q < query.rows; ++q) {
+			const float *a = query.ptr<float>(q);
+			float globalBest = HUGE_VAL;
+			for (int f = 0; f < index; ++f) {
+				bestDist[f] = secondBestDist[f] = HUGE_VAL;
+				const cv::Mat &pool = frames[f].signature;
+				if (pool.cols != query.cols)
+					continue;
+				for (int r = 0; r < pool.rows; ++r) {
+					const float *b = pool.ptr<float>(r);
+					float d = 0;
+					for (int k = 0; k < query.cols; ++k)
+						d += (a[k] - b[k]) * (a[k] - b[k]);
+					if (d < bestDist[f]) {
+						secondBestDist[f] = bestDist[f];
+						bestDist[f] = d;
+					} else if (d < secondBestDist[f]) {
+						secondBestDist[f] = d;
+					}
+				}
+				globalBest = std::min(globalBest, bestDist[f]);
+			}
+			bool distinct = globalBest < HUGE_VAL;
+			for (int f = 0; f < index && distinct; ++f) {
+				if (ratio * bestDist[f] <= globalBest)
+					distinct = globalBest < ratio * secondBestDist[f];
+			}
+			for (int f = 0; f < index && distinct; ++f) {
+				if (ratio * bestDist[f] <= globalBest)
+					++votes[f];
+			}
+		}
+
+		// mindestens zwei Stimmen, bei Gleichstand das jüngere Bild zuerst
+		std::vector<std::pair<int, int> > ranked;
+		for (int f = 0; f < index; ++f) {
+			if (votes[f] >= 2 && std::find(result.begin(), result.end(), f) == result.end())
+				ranked.push_back(std::make_pair(votes[f], f));
+		}
+		std::sort(ranked.rbegin(), ranked.rend());
+		for (int i = 0; i < (int)ranked.size() && i < candidates; ++i)
+			result.push_back(ranked[i].second);
+		return result;
+	}
+
+	/**
+	 * Prim von start aus: Kanten von platzierten zu nicht platzierten Bildern
+	 * nach absteigender Inlierzahl. Ist start selbst nicht platziert, wird es
+	 * zuerst über seine beste Kante zu einem platzierten Bild eingehängt.
+	 * Schon platzierte Bilder bleiben unverändert.
+	 */
+	void grow(int start) {
+		std::priority_queue<std::pair<int, int> > queue;
+		if (!frames[start].placed) {
+			pushEdges(start, queue);
+			while (!queue.empty() && !frames[start].placed) {
+				attach(queue.top().second);
+				queue.pop();
+			}
+			if (!frames[start].placed)
+				return;
+			queue = std::priority_queue<std::pair<int, int> >();
+		}
+		pushEdges(start, queue);
+		while (!queue.empty()) {
+			int e = queue.top().second;
+			queue.pop();
+			int child = attach(e);
+			if (child >= 0)
+				pushEdges(child, queue);
+		}
+	}
+
+	/**
+	 * Hängt das nicht platzierte Ende der Kante e an das platzierte; liefert
+	 * dessen Index oder -1.
+	 */
+	int attach(int e) {
+		const PanoramaEdge &edge = edges[e];
+		bool fromPlaced = frames[edge.from].placed, toPlaced = frames[edge.to].placed;
+		if (fromPlaced == toPlaced)
+			return -1;
+		int parent = fromPlaced ? edge.from : edge.to, child = fromPlaced ? edge.to : edge.from;
+		cv::Mat_<double> H;
+		edge.H.convertTo(H, CV_64F);
+		cv::Mat_<double> childToParent = child == edge.from ? H : cv::Mat_<double>(H.inv());
+		cv::Mat_<double> transform = cv::Mat_<double>(frames[parent].transform) * childToParent;
+		return place(child, parent, transform) ? child : -1;
+	}
+
+	void pushEdges(int frame, std::priority_queue<std::pair<int, int> > &queue) const {
+		for (size_t i = 0; i < frames[frame].edges.size(); ++i) {
+			int e = frames[frame].edges[i];
+			queue.push(std::make_pair(edges[e].inliers, e));
+		}
+	}
+
+	/** Platziert frame mit transform; false, wenn eine Ecke hinter der Referenz läge */
+	bool place(int frame, int parent, const cv::Mat &transform) {
+		if (transform.at<double>(2, 2) == 0)
+			return false;
+		cv::Mat_<double> t = transform / transform.at<double>(2, 2);
+		cv::Size size = frames[frame].size;
+		double corners[4][2] = { { 0, 0 }, { size.width - 1.0, 0 }, { size.width - 1.0, size.height - 1.0 }, { 0, size.height - 1.0 } };
+		for (int i = 0; i < 4; ++i) {
+			if (t(2, 0) * corners[i][0] + t(2, 1) * corners[i][1] + t(2, 2) <= 0)
+				return false;
+		}
+		Frame &f = frames[frame];
+		f.transform = t;
+		f.parent = parent;
+		f.placed = true;
+		cv::Rect rect = projectedBounds(t, size);
+		area = placedFrames == 0 ? rect : area | rect;
+		++placedFrames;
+		return true;
+	}
+
+	Registration registration;
+	int candidates, neighbours, minInliers;
+	float ratio;
+	std::vector<Frame> frames;
+	std::vector<PanoramaEdge> edges;
+	size_t registered;
+	int placedFrames;
+	cv::Rect area;
+};
+
+#endif
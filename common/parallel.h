@@ -0,0 +1,140 @@
+/**
+ * Parallele Ausführung von Schleifen über Bildzeilen.
+ *
+ * Das Bild wird in Bänder fester Höhe zerlegt, die von einem festen Satz
+ * Arbeitsthreads (plus dem aufrufenden Thread) abgearbeitet werden. Jedes Band
+ * schreibt nur seine eigenen Zeilen, daher ist das Ergebnis unabhängig von der
+ * Anzahl der Threads und der Reihenfolge der Bänder.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class RowBandExecutor {
+public:
+	/**
+	 * threads = 0 verwendet alle Hardware-Threads.
+	 */
+	explicit RowBandExecutor(int threads = 0, int bandHeight = 64)
+		: bandHeight(std::max(bandHeight, 1)), job(0), jobRows(0), jobBand(1), nextBand(0), generation(0), pending(0), stop(false) {
+		if (threads <= 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		for (int i = 1; i < threads; ++i)
+			workers.push_back(std::thread(&RowBandExecutor::workerLoop, this));
+	}
+
+	~RowBandExecutor() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		wake.notify_all();
+		for (size_t i = 0; i < workers.size(); ++i)
+			workers[i].join();
+	}
+
+	int threads() const { return (int)workers.size() + 1; }
+
+	int getBandHeight() const { return bandHeight; }
+	void setBandHeight(int height) { bandHeight = std::max(height, 1); }
+
+	/**
+	 * Ruft body(y0, y1) für alle Bänder [y0, y1) von [0, rows) auf und kehrt
+	 * zurück, wenn alle Bänder fertig sind. Wirft body in einem Band, werden
+	 * die noch nicht begonnenen Bänder übersprungen; run() wartet trotzdem
+	 * auf alle Threads und wirft danach die erste Ausnahme weiter.
+	 */
+	void run(int rows, const std::function<void(int, int)> &body) {
+		if (rows <= 0)
+			return;
+		if (workers.empty() || rows <= bandHeight) {
+			for (int y = 0; y < rows; y += bandHeight)
+				body(y, std::min(y + bandHeight, rows));
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &body;
+			jobRows = rows;
+			jobBand = bandHeight;
+			nextBand = 0;
+			pending = (int)workers.size();
+			++generation;
+		}
+		wake.notify_all();
+		processBands();
+
+		std::exception_ptr failure;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			done.wait(lock, [this] { return pending == 0; });
+			job = 0;
+			std::swap(failure, error);
+		}
+		if (failure)
+			std::rethrow_exception(failure);
+	}
+
+private:
+	void processBands() {
+		try {
+			for (;;) {
+				int y = (nextBand++) * jobBand;
+				if (y >= jobRows)
+					break;
+				(*job)(y, std::min(y + jobBand, jobRows));
+			}
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!error)
+				error = std::current_exception();
+			// übrige Bänder nicht mehr vergeben
+			nextBand = jobRows / jobBand + 1;
+		}
+	}
+
+	void workerLoop() {
+		unsigned seen = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return stop || generation != seen; });
+				if (stop)
+					return;
+				seen = generation;
+			}
+			processBands();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				--pending;
+			}
+			done.notify_one();
+		}
+	}
+
+	int bandHeight;
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake, done;
+
+	// Zustand des aktuellen Auftrags
+	const std::function<void(int, int)> *job;
+	int jobRows, jobBand;
+	std::atomic<int> nextBand;
+	unsigned generation;
+	int pending;
+	bool stop;
+	/** erste Ausnahme aus body im aktuellen Auftrag */
+	std::exception_ptr error;
+};
+
+#endif
@@ -0,0 +1,389 @@
+/**
+ * Panoramaleinwand aus Kacheln fester Größe für Mosaike, die nicht in den
+ * Hauptspeicher passen.
+ *
+ * Eine Kachel hält Summe und Anzahl der Beiträge wie PanoramaCanvas und wird
+ * erst angelegt, wenn ein gewarptes Bild sie tatsächlich trifft. Höchstens
+ * maxResident Kacheln liegen im Speicher; darüber wird die am längsten nicht
+ * benutzte in eine Auslagerungsdatei geschrieben und bei Bedarf wieder
+ * gelesen. Fertige Kachelzeilen gehen zeilenweise an einen TileWriter und
+ * werden danach freigegeben; StripWriter schreibt daraus ein PGM/PPM, ohne das
+ * Panorama je ganz zu halten. Der Speicherbedarf hängt damit von maxResident
+ * und der Breite einer Kachelzeile ab, nicht von der Fläche des Panoramas.
+ *
+ * Die Kacheln liegen auf einem festen Raster der Zielebene und werden nach
+ * ihren (auch negativen) Rasterkoordinaten verwaltet. Eine Leinwand ohne
+ * vorgegebene Fläche wächst daher mit jedem Bild, ohne schon aufsummierte
+ * Kacheln anzufassen; Bilder können hinzugefügt werden, sobald ihre Lage
+ * feststeht (etwa nach PanoramaGraph::append()). Wachsen kann sie nur bis zur
+ * ersten Ausgabe, da dann die Größe des Ausgabebildes feststeht.
+ */
+
+#ifndef TILEDCANVAS_H
+#define TILEDCANVAS_H
+
+#include <cstdio>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <cv.h>
+
+#include "panorama.h"
+
+class TileWriter {
+public:
+	virtual ~TileWriter() {}
+
+	/**
+	 * Kachel rect (Leinwandkoordinaten) mit den Mittelwerten der Beiträge;
+	 * leer, wenn kein Bild die Kachel getroffen hat. Kacheln kommen
+	 * zeilenweise von links oben nach rechts unten.
+	 */
+	virtual void write(const cv::Rect &rect, const cv::Mat &tile) = 0;
+};
+
+/**
+ * Setzt die Kacheln zu einem Bild zusammen (z.B. zum Anzeigen kleiner
+ * Panoramen).
+ */
+class MatWriter : public TileWriter {
+public:
+	MatWriter(cv::Size size, int type) : image(size, type, cv::Scalar::all(0)) {}
+
+	void write(const cv::Rect &rect, const cv::Mat &tile) {
+		if (!tile.empty()) {
+			cv::Mat target = image(rect);
+			tile.copyTo(target);
+		}
+	}
+
+	cv::Mat image;
+};
+
+/**
+ * Schreibt die Kacheln als binäres PGM (ein Kanal) bzw. PPM (drei Kanäle,
+ * BGR) mit 8 Bit, Werte mit scale multipliziert. Gehalten wird nur eine
+ * Kachelzeile.
+ */
+class StripWriter : public TileWriter {
+public:
+	StripWriter(const std::string &path, cv::Size size, int channels, double scale = 255.0)
+		: size(size), channels(channels), scale(scale), bandY(0), nextX(0) {
+		CV_Assert(channels == 1 || channels == 3);
+		file = fopen(path.c_str(), "wb");
+		if (!file)
+			CV_Error(CV_StsError, "cannot open " + path);
+		fprintf(file, "P%d\n%d %d\n255\n", channels == 1 ? 5 : 6, size.width, size.height);
+	}
+
+	~StripWriter() {
+		fclose(file);
+	}
+
+	void write(const cv::Rect &rect, const cv::Mat &tile) {
+		CV_Assert(rect.y == bandY && rect.x == nextX);
+		if (band.rows != rect.height)
+			band.create(rect.height, size.width, CV_8UC(channels));
+		cv::Mat target = band(cv::Rect(rect.x, 0, rect.width, rect.height));
+		if (tile.empty())
+			target = cv::Scalar::all(0);
+		else
+			tile.convertTo(target, target.type(), scale);
+		nextX = rect.x + rect.width;
+		if (nextX < size.width)
+			return;
+
+		std::vector<uchar> row(size.width * channels);
+		for (int y = 0; y < band.rows; ++y) {
+			const uchar *b = band.ptr<uchar>(y);
+			for (int x = 0; x < size.width; ++x) {
+				for (int k = 0; k < channels; ++k)
+					row[x * channels + k] = b[x * channels + channels - 1 - k];
+			}
+			if (fwrite(&row[0], 1, row.size(), file) != row.size())
+				CV_Error(CV_StsError, "write failed");
+		}
+		bandY += rect.height;
+		nextX = 0;
+	}
+
+private:
+	StripWriter(const StripWriter &);
+	StripWriter &operator=(const StripWriter &);
+
+	cv::Size size;
+	int channels;
+	double scale;
+	FILE *file;
+	cv::Mat band;
+	int bandY, nextX;
+};
+
+struct TiledCanvasStats {
+	size_t tilesCreated;
+	size_t residentTiles;
+	size_t peakResidentTiles;
+	/** Schreib- und Lesevorgänge der Auslagerungsdatei */
+	size_t spills, reloads;
+
+	TiledCanvasStats() : tilesCreated(0), residentTiles(0), peakResidentTiles(0), spills(0), reloads(0) {}
+};
+
+class TiledCanvas {
+public:
+	static const int DEFAULT_TILE_SIZE = 256;
+
+	/**
+	 * Leinwand über area (Koordinaten der Zielebene) vom Typ CV_32FC(n) mit
+	 * quadratischen Kacheln der Kantenlänge tileSize, von denen höchstens
+	 * maxResident im Speicher liegen. Ist area leer, wächst die Leinwand mit
+	 * jedem Bild (Raster ab dem Ursprung der Zielebene), sonst werden die
+	 * Bilder auf area beschnitten. Ausgelagert wird nach spillPath (wird
+	 * beim Zerstören gelöscht) oder, wenn leer, in eine temporäre Datei. Mit
+	 * executor werden die Zeilen jeder Kachel parallel gewarpt.
+	 */
+	TiledCanvas(const cv::Rect &area, int type = CV_32FC1, int tileSize = DEFAULT_TILE_SIZE, size_t maxResident = 256,
+			const std::string &spillPath = "", RowBandExecutor *executor = 0)
+		: area(area), origin(area.tl()), growing(area.width <= 0 || area.height <= 0), type(type), tileSize(tileSize),
+		  maxResident(maxResident), spillPath(spillPath), spill(0), nextSlot(0), emitting(false), nextRow(0),
+		  executor(executor) {
+		CV_Assert(CV_MAT_DEPTH(type) == CV_32F && tileSize > 0 && maxResident > 0);
+		if (growing)
+			this->area = cv::Rect();
+	}
+
+	~TiledCanvas() {
+		if (spill) {
+			fclose(spill);
+			if (!spillPath.empty())
+				remove(spillPath.c_str());
+		}
+	}
+
+	/** Bisherige Fläche (Zielebene); wächst bei einer Leinwand ohne Vorgabe */
+	const cv::Rect &bounds() const { return area; }
+
+	/** Anzahl der Kacheln über bounds() in x- und y-Richtung */
+	cv::Size gridSize() const {
+		if (empty())
+			return cv::Size();
+		return cv::Size(lastColumn() - firstColumn() + 1, lastRow() - firstRow() + 1);
+	}
+
+	const TiledCanvasStats &stats() const { return statistics; }
+
+	/**
+	 * Fügt image (Typ der Leinwand, Werte >= 0) mit der Homographie H (Bild →
+	 * Zielebene) hinzu wie PanoramaCanvas::add(); liefert den getroffenen
+	 * Ausschnitt relativ zu bounds(). Das Bild darf keine schon ausgegebenen
+	 * Kachelzeilen treffen und eine wachsende Leinwand nach der ersten
+	 * Ausgabe nicht mehr vergrößern.
+	 */
+	cv::Rect add(const cv::Mat &image, const cv::Mat &H) {
+		CV_Assert(image.type() == type);
+		cv::Mat_<double> h;
+		H.convertTo(h, CV_64F);
+		cv::Rect bounds = projectedBounds(h, image.size());
+		if (growing) {
+			CV_Assert(!emitting || (bounds & area) == bounds);
+			area = empty() ? bounds : area | bounds;
+		}
+		cv::Rect roi = bounds & area;
+		if (roi.width <= 0 || roi.height <= 0)
+			return cv::Rect();
+		CV_Assert(!emitting || roi.y >= origin.y + nextRow * tileSize);
+
+		panorama_detail::Placement placement(h, image.size());
+		int tx0 = floorDiv(roi.x - origin.x), tx1 = floorDiv(roi.x + roi.width - 1 - origin.x);
+		int ty0 = floorDiv(roi.y - origin.y), ty1 = floorDiv(roi.y + roi.height - 1 - origin.y);
+		for (int ty = ty0; ty <= ty1; ++ty) {
+			for (int tx = tx0; tx <= tx1; ++tx) {
+				cv::Rect part = roi & tileRect(tx, ty);
+				cv::Mat patch;
+				placement.place(image, part, scratch, patch, spans, executor);
+				if (!panorama_detail::anyCovered(spans))
+					continue;
+				Tile &tile = fetch(TileKey(tx, ty), true);
+				cv::Rect local = part - tileOrigin(tx, ty);
+				panorama_detail::accumulate(patch, spans, tile.sum(local), tile.count(local));
+			}
+		}
+		return roi - area.tl();
+	}
+
+	/**
+	 * Gibt alle noch offenen Kachelzeilen, die ganz oberhalb der Zeile y
+	 * (relativ zu bounds()) liegen, an writer und gibt sie frei. Danach dürfen
+	 * keine Bilder mehr über y hinzugefügt werden, und die Leinwand wächst
+	 * nicht mehr. writer erhält Rechtecke relativ zu bounds().
+	 */
+	void flushAbove(int y, TileWriter &writer) {
+		if (!emitting) {
+			emitting = true;
+			nextRow = empty() ? 0 : firstRow();
+		}
+		if (empty())
+			return;
+		int rows = y >= area.height ? lastRow() + 1 : std::min(floorDiv(area.y + y - origin.y), lastRow() + 1);
+		for (; nextRow < rows; ++nextRow) {
+			for (int tx = firstColumn(); tx <= lastColumn(); ++tx) {
+				cv::Rect rect = tileRect(tx, nextRow);
+				TileKey key(tx, nextRow);
+				if (tiles.find(key) == tiles.end()) {
+					writer.write(rect - area.tl(), cv::Mat());
+					continue;
+				}
+				Tile &tile = fetch(key, false);
+				cv::Rect local = rect - tileOrigin(tx, nextRow);
+				cv::Mat sum = tile.sum(local);
+				panorama_detail::normalize(sum, tile.count(local));
+				writer.write(rect - area.tl(), sum);
+				drop(key);
+			}
+		}
+	}
+
+	/** Gibt alle übrigen Kacheln aus */
+	void finish(TileWriter &writer) {
+		flushAbove(area.height, writer);
+	}
+
+private:
+	/** Rasterkoordinaten (tx, ty) einer Kachel */
+	typedef std::pair<int, int> TileKey;
+
+	struct Tile {
+		/** leer, solange die Kachel ausgelagert ist */
+		cv::Mat sum, count;
+		/** Platz in der Auslagerungsdatei, -1 solange nie ausgelagert */
+		long long slot;
+		std::list<TileKey>::iterator use;
+	};
+
+	TiledCanvas(const TiledCanvas &);
+	TiledCanvas &operator=(const TiledCanvas &);
+
+	bool empty() const { return area.width <= 0 || area.height <= 0; }
+
+	/** Rasterindex der Koordinate v (relativ zu origin), auch für negative v */
+	int floorDiv(int v) const { return v >= 0 ? v / tileSize : -((tileSize - 1 - v) / tileSize); }
+
+	int firstColumn() const { return floorDiv(area.x - origin.x); }
+	int lastColumn() const { return floorDiv(area.x + area.width - 1 - origin.x); }
+	int firstRow() const { return floorDiv(area.y - origin.y); }
+	int lastRow() const { return floorDiv(area.y + area.height - 1 - origin.y); }
+
+	cv::Point tileOrigin(int tx, int ty) const { return origin + cv::Point(tx * tileSize, ty * tileSize); }
+
+	/** Kachel (tx, ty) in der Zielebene, auf bounds() beschnitten */
+	cv::Rect tileRect(int tx, int ty) const {
+		return cv::Rect(tileOrigin(tx, ty), cv::Size(tileSize, tileSize)) & area;
+	}
+
+	size_t sumBytes() const { return (size_t)tileSize * tileSize * CV_ELEM_SIZE(type); }
+
+	size_t countBytes() const { return (size_t)tileSize * tileSize * sizeof(ushort); }
+
+	size_t slotBytes() const { return sumBytes() + countBytes(); }
+
+	/**
+	 * Kachel im Speicher, zuletzt benutzt; legt sie bei create an, lädt sie
+	 * bei Bedarf aus der Auslagerungsdatei.
+	 */
+	Tile &fetch(const TileKey &key, bool create) {
+		std::map<TileKey, Tile>::iterator it = tiles.find(key);
+		if (it != tiles.end() && !it->second.sum.empty()) {
+			lru.splice(lru.begin(), lru, it->second.use);
+			return it->second;
+		}
+		CV_Assert(it != tiles.end() || create);
+		makeRoom();
+		if (it == tiles.end()) {
+			it = tiles.insert(std::make_pair(key, Tile())).first;
+			it->second.slot = -1;
+			++statistics.tilesCreated;
+		}
+		Tile &tile = it->second;
+		tile.sum.create(tileSize, tileSize, type);
+		tile.count.create(tileSize, tileSize, CV_16UC1);
+		if (tile.slot < 0) {
+			tile.sum = cv::Scalar::all(0);
+			tile.count = cv::Scalar(0);
+		} else {
+			seek(tile.slot);
+			if (fread(tile.sum.data, 1, sumBytes(), spill) != sumBytes()
+					|| fread(tile.count.data, 1, countBytes(), spill) != countBytes())
+				CV_Error(CV_StsError, "reading tile from spill file failed");
+			++statistics.reloads;
+		}
+		lru.push_front(key);
+		tile.use = lru.begin();
+		statistics.residentTiles++;
+		statistics.peakResidentTiles = std::max(statistics.peakResidentTiles, statistics.residentTiles);
+		return tile;
+	}
+
+	/** Lagert die am längsten nicht benutzte Kachel aus, wenn kein Platz mehr ist */
+	void makeRoom() {
+		if (statistics.residentTiles < maxResident)
+			return;
+		TileKey key = lru.back();
+		Tile &tile = tiles[key];
+		if (!spill) {
+			spill = spillPath.empty() ? tmpfile() : fopen(spillPath.c_str(), "w+b");
+			if (!spill)
+				CV_Error(CV_StsError, "cannot open spill file");
+		}
+		if (tile.slot < 0)
+			tile.slot = nextSlot++;
+		seek(tile.slot);
+		if (fwrite(tile.sum.data, 1, sumBytes(), spill) != sumBytes()
+				|| fwrite(tile.count.data, 1, countBytes(), spill) != countBytes())
+			CV_Error(CV_StsError, "writing tile to spill file failed");
+		++statistics.spills;
+		release(tile);
+	}
+
+	/** Kachel endgültig entfernen (ihr Platz in der Datei wird nicht wiederverwendet) */
+	void drop(const TileKey &key) {
+		release(tiles[key]);
+		tiles.erase(key);
+	}
+
+	void release(Tile &tile) {
+		if (tile.sum.empty())
+			return;
+		lru.erase(tile.use);
+		tile.sum.release();
+		tile.count.release();
+		statistics.residentTiles--;
+	}
+
+	void seek(long long slot) {
+		if (fseeko(spill, (off_t)(slot * (long long)slotBytes()), SEEK_SET) != 0)
+			CV_Error(CV_StsError, "seek in spill file failed");
+	}
+
+	cv::Rect area;
+	/** Ursprung des Kachelrasters in der Zielebene */
+	cv::Point origin;
+	bool growing;
+	int type, tileSize;
+	size_t maxResident;
+	std::string spillPath;
+	FILE *spill;
+	long long nextSlot;
+	/** Ausgabe begonnen, nächste auszugebende Kachelzeile */
+	bool emitting;
+	int nextRow;
+	std::map<TileKey, Tile> tiles;
+	/** vorne die zuletzt benutzte Kachel */
+	std::list<TileKey> lru;
+	cv::Mat scratch;
+	std::vector<WarpSpan> spans;
+	RowBandExecutor *executor;
+	TiledCanvasStats statistics;
+};
+
+#endif
@@ -0,0 +1,192 @@
+/**
+ * Perspektivisches Warpen durch Rückwärtsabbildung, beschränkt auf die
+ * Pixel, die vom Quellbild tatsächlich überdeckt werden.
+ *
+ * Für eine Zielzeile sind Zähler und Nenner der inversen Homographie linear
+ * in x. Die Bedingungen "Nenner > 0" und "Urbild in [0, w-1] x [0, h-1]" sind
+ * damit lineare Ungleichungen in x, deren Schnitt die überdeckte Spanne der
+ * Zeile ergibt. Nur diese Spanne wird interpoliert; Zähler und Nenner werden
+ * dabei pro Pixel nur um einen festen Schritt erhöht. Einkanalige Bilder
+ * werden mit SSE2 vier Pixel auf einmal bilinear interpoliert, Zeilenbänder
+ * können auf einen RowBandExecutor verteilt werden.
+ */
+
+#ifndef WARP_H
+#define WARP_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <cv.h>
+
+#include "parallel.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/** Spalten [begin, end) einer Zielzeile */
+struct WarpSpan {
+	int begin, end;
+
+	WarpSpan() : begin(0), end(0) {}
+	WarpSpan(int begin, int end) : begin(begin), end(end) {}
+
+	int width() const { return end - begin; }
+};
+
+class PerspectiveWarp {
+public:
+	/**
+	 * H (3x3) bildet das Quellbild der Größe source (mindestens 2x2) auf die
+	 * Zielebene ab.
+	 */
+	PerspectiveWarp(const cv::Mat &H, cv::Size source) : source(source) {
+		CV_Assert(source.width >= 2 && source.height >= 2);
+		cv::Mat_<double> h;
+		H.convertTo(h, CV_64F);
+		cv::Mat_<double> inv = h.inv();
+		for (int i = 0; i < 9; ++i)
+			m[i] = inv(i / 3, i % 3);
+		// Vorzeichen so wählen, dass der Nenner vor der Kamera positiv ist
+		double cx = (source.width - 1) / 2.0, cy = (source.height - 1) / 2.0;
+		double w = h(2, 0) * cx + h(2, 1) * cy + h(2, 2);
+		double px = (h(0, 0) * cx + h(0, 1) * cy + h(0, 2)) / w, py = (h(1, 0) * cx + h(1, 1) * cy + h(1, 2)) / w;
+		if (m[6] * px + m[7] * py + m[8] < 0) {
+			for (int i = 0; i < 9; ++i)
+				m[i] = -m[i];
+		}
+	}
+
+	/**
+	 * Spalten der Zielzeile y innerhalb von [x0, x1), deren Urbild mit allen
+	 * vier bilinearen Nachbarn im Quellbild liegt.
+	 */
+	WarpSpan span(int y, int x0, int x1) const {
+		double lo = x0, hi = x1 - 1;
+		double u = m[1] * y + m[2], v = m[4] * y + m[5], d = m[7] * y + m[8];
+		double umax = source.width - 1, vmax = source.height - 1;
+		constrain(m[6], d, lo, hi);
+		constrain(m[0], u, lo, hi);
+		constrain(umax * m[6] - m[0], umax * d - u, lo, hi);
+		constrain(m[3], v, lo, hi);
+		constrain(vmax * m[6] - m[3], vmax * d - v, lo, hi);
+		if (lo > hi)
+			return WarpSpan(x0, x0);
+		int begin = std::max(x0, (int)std::ceil(lo - 1e-9)), end = std::min(x1, (int)std::floor(hi + 1e-9) + 1);
+		return begin < end ? WarpSpan(begin, end) : WarpSpan(x0, x0);
+	}
+
+	/**
+	 * Warpt src (CV_32FC(n), Größe wie im Konstruktor) in den Ausschnitt rect
+	 * der Zielebene: dst bekommt die Größe von rect, spans[y] die beschriebenen
+	 * Spalten der Zeile y (relativ zu rect). Pixel außerhalb der Spannen
+	 * bleiben unverändert. Liefert die Anzahl der geschriebenen Pixel.
+	 */
+	size_t warp(const cv::Mat &src, const cv::Rect &rect, cv::Mat &dst, std::vector<WarpSpan> &spans,
+			RowBandExecutor *executor = 0) const {
+		CV_Assert(src.depth() == CV_32F && src.size() == source);
+		dst.create(rect.size(), src.type());
+		spans.resize(rect.height);
+		std::function<void(int, int)> body = [&](int y0, int y1) {
+			for (int y = y0; y < y1; ++y) {
+				WarpSpan s = span(rect.y + y, rect.x, rect.x + rect.width);
+				spans[y] = WarpSpan(s.begin - rect.x, s.end - rect.x);
+				warpRow(src, dst.ptr<float>(y) + spans[y].begin * src.channels(), s.begin, rect.y + y, s.width());
+			}
+		};
+		if (executor)
+			executor->run(rect.height, body);
+		else
+			body(0, rect.height);
+		size_t written = 0;
+		for (int y = 0; y < rect.height; ++y)
+			written += spans[y].width();
+		return written;
+	}
+
+private:
+	/** Schränkt [lo, hi] auf a x + b >= 0 ein */
+	static void constrain(double a, double b, double &lo, double &hi) {
+		if (a > 0)
+			lo = std::max(lo, -b / a);
+		else if (a < 0)
+			hi = std::min(hi, -b / a);
+		else if (b < 0)
+			hi = lo - 1;
+	}
+
+	/** n Pixel der Zeile y ab Spalte x nach dst */
+	void warpRow(const cv::Mat &src, float *dst, int x, int y, int n) const {
+		if (n <= 0)
+			return;
+		// Zähler und Nenner der Rückabbildung am ersten Pixel, danach nur Additionen
+		double u0 = m[0] * x + m[1] * y + m[2], v0 = m[3] * x + m[4] * y + m[5], d0 = m[6] * x + m[7] * y + m[8];
+		const float umax = (float)(source.width - 1), vmax = (float)(source.height - 1);
+		const float xlast = (float)(source.width - 2), ylast = (float)(source.height - 2);
+		const int cn = src.channels();
+		const size_t step = src.step / sizeof(float);
+		const float *s = src.ptr<float>();
+		int i = 0;
+
+#if defined(__SSE2__)
+		if (cn == 1) {
+			__m128d u01 = _mm_setr_pd(u0, u0 + m[0]), u23 = _mm_setr_pd(u0 + 2 * m[0], u0 + 3 * m[0]);
+			__m128d v01 = _mm_setr_pd(v0, v0 + m[3]), v23 = _mm_setr_pd(v0 + 2 * m[3], v0 + 3 * m[3]);
+			__m128d d01 = _mm_setr_pd(d0, d0 + m[6]), d23 = _mm_setr_pd(d0 + 2 * m[6], d0 + 3 * m[6]);
+			const __m128d du = _mm_set1_pd(4 * m[0]), dv = _mm_set1_pd(4 * m[3]), dd = _mm_set1_pd(4 * m[6]);
+			const __m128d one = _mm_set1_pd(1.0);
+			const __m128 zero = _mm_setzero_ps(), umax4 = _mm_set1_ps(umax), vmax4 = _mm_set1_ps(vmax);
+			const __m128 xlast4 = _mm_set1_ps(xlast), ylast4 = _mm_set1_ps(ylast);
+			int ix[4], iy[4];
+			for (; i + 4 <= n; i += 4) {
+				__m128d r01 = _mm_div_pd(one, d01), r23 = _mm_div_pd(one, d23);
+				__m128 u = _mm_movelh_ps(_mm_cvtpd_ps(_mm_mul_pd(u01, r01)), _mm_cvtpd_ps(_mm_mul_pd(u23, r23)));
+				__m128 v = _mm_movelh_ps(_mm_cvtpd_ps(_mm_mul_pd(v01, r01)), _mm_cvtpd_ps(_mm_mul_pd(v23, r23)));
+				u = _mm_min_ps(_mm_max_ps(u, zero), umax4);
+				v = _mm_min_ps(_mm_max_ps(v, zero), vmax4);
+				// linker/oberer Nachbar; am rechten/unteren Rand mit Anteil 1 auf den vorletzten
+				__m128 fu = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(u)), xlast4);
+				__m128 fv = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(v)), ylast4);
+				_mm_storeu_si128((__m128i *)ix, _mm_cvttps_epi32(fu));
+				_mm_storeu_si128((__m128i *)iy, _mm_cvttps_epi32(fv));
+				const float *p0 = s + iy[0] * step + ix[0], *p1 = s + iy[1] * step + ix[1];
+				const float *p2 = s + iy[2] * step + ix[2], *p3 = s + iy[3] * step + ix[3];
+				__m128 a = _mm_setr_ps(p0[0], p1[0], p2[0], p3[0]);
+				__m128 b = _mm_setr_ps(p0[1], p1[1], p2[1], p3[1]);
+				__m128 c = _mm_setr_ps(p0[step], p1[step], p2[step], p3[step]);
+				__m128 d = _mm_setr_ps(p0[step + 1], p1[step + 1], p2[step + 1], p3[step + 1]);
+				__m128 ax = _mm_sub_ps(u, fu), ay = _mm_sub_ps(v, fv);
+				__m128 top = _mm_add_ps(a, _mm_mul_ps(ax, _mm_sub_ps(b, a)));
+				__m128 bottom = _mm_add_ps(c, _mm_mul_ps(ax, _mm_sub_ps(d, c)));
+				_mm_storeu_ps(dst + i, _mm_add_ps(top, _mm_mul_ps(ay, _mm_sub_ps(bottom, top))));
+				u01 = _mm_add_pd(u01, du); u23 = _mm_add_pd(u23, du);
+				v01 = _mm_add_pd(v01, dv); v23 = _mm_add_pd(v23, dv);
+				d01 = _mm_add_pd(d01, dd); d23 = _mm_add_pd(d23, dd);
+			}
+		}
+#endif
+
+		double u = u0 + i * m[0], v = v0 + i * m[3], d = d0 + i * m[6];
+		for (; i < n; ++i, u += m[0], v += m[3], d += m[6]) {
+			double r = 1.0 / d;
+			float fu = std::min(std::max((float)(u * r), 0.0f), umax);
+			float fv = std::min(std::max((float)(v * r), 0.0f), vmax);
+			float bu = std::min((float)(int)fu, xlast), bv = std::min((float)(int)fv, ylast);
+			float ax = fu - bu, ay = fv - bv;
+			const float *p = s + (int)bv * step + (int)bu * cn;
+			float *q = dst + i * cn;
+			for (int k = 0; k < cn; ++k) {
+				float top = p[k] + ax * (p[k + cn] - p[k]);
+				float bottom = p[k + step] + ax * (p[k + step + cn] - p[k + step]);
+				q[k] = top + ay * (bottom - top);
+			}
+		}
+	}
+
+	cv::Size source;
+	/** inverse Homographie, Zielebene → Quellbild, zeilenweise */
+	double m[9];
+};
+
+#endif
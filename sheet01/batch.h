@@ -0,0 +1,233 @@
+/**
+ * Stapelverarbeitung ohne GUI: Laden -> Entzerren -> Speichern.
+ *
+ * Die drei Stufen laufen in eigenen Threads und sind durch Warteschlangen
+ * begrenzter Länge verbunden, so dass Dekodieren, Rechnen und Kodieren
+ * überlappen und der Speicherbedarf konstant bleibt.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <glob.h>
+#include <sys/stat.h>
+
+#include <cv.h>
+#include <highgui.h>
+
+#include "undistort.h"
+
+/**
+ * Warteschlange mit fester Kapazität: push() blockiert, solange sie voll ist,
+ * pop() solange sie leer ist. Nach close() liefert pop() false, sobald alle
+ * Elemente entnommen wurden.
+ */
+template<typename T>
+class BoundedQueue {
+public:
+	explicit BoundedQueue(size_t capacity) : capacity(std::max(capacity, (size_t)1)), closed(false) {}
+
+	void push(T item) {
+		std::unique_lock<std::mutex> lock(mutex);
+		notFull.wait(lock, [this] { return items.size() < capacity; });
+		items.push_back(std::move(item));
+		notEmpty.notify_one();
+	}
+
+	bool pop(T &item) {
+		std::unique_lock<std::mutex> lock(mutex);
+		notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+		if (items.empty())
+			return false;
+		item = std::move(items.front());
+		items.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	void close() {
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		notEmpty.notify_all();
+	}
+
+private:
+	size_t capacity;
+	bool closed;
+	std::deque<T> items;
+	std::mutex mutex;
+	std::condition_variable notFull, notEmpty;
+};
+
+struct BatchFrame {
+	std::string name;
+	cv::Mat image;
+};
+
+/**
+ * Alle Dateien eines Verzeichnisses oder alle Treffer eines Glob-Musters,
+ * sortiert.
+ */
+inline std::vector<std::string> listInputs(const std::string &input) {
+	std::vector<std::string> files;
+	struct stat st;
+	if (stat(input.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+		DIR *dir = opendir(input.c_str());
+		if (!dir)
+			return files;
+		while (struct dirent *entry = readdir(dir)) {
+			std::string path = input + "/" + entry->d_name;
+			if (entry->d_name[0] != '.' && stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+				files.push_back(path);
+		}
+		closedir(dir);
+	} else {
+		glob_t matches;
+		if (glob(input.c_str(), 0, 0, &matches) == 0) {
+			for (size_t i = 0; i < matches.gl_pathc; ++i)
+				files.push_back(matches.gl_pathv[i]);
+		}
+		globfree(&matches);
+	}
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+/**
+ * Ausgabenamen: der Dateiname, wenn er unter den Eingaben eindeutig ist,
+ * sonst der ganze Pfad mit '_' statt '/'. Bleibt ein Name trotzdem doppelt,
+ * ist er für alle Beteiligten leer.
+ */
+inline std::vector<std::string> outputNames(const std::vector<std::string> &files) {
+	std::vector<std::string> names(files.size());
+	std::map<std::string, int> count;
+	for (size_t i = 0; i < files.size(); ++i) {
+		names[i] = files[i].substr(files[i].find_last_of('/') + 1);
+		++count[names[i]];
+	}
+	for (size_t i = 0; i < files.size(); ++i) {
+		if (count[names[i]] == 1)
+			continue;
+		std::string path = files[i];
+		while (path.compare(0, 2, "./") == 0)
+			path.erase(0, 2);
+		path.erase(0, path.find_first_not_of('/'));
+		std::replace(path.begin(), path.end(), '/', '_');
+		names[i] = path;
+	}
+	count.clear();
+	for (size_t i = 0; i < names.size(); ++i)
+		++count[names[i]];
+	for (size_t i = 0; i < names.size(); ++i) {
+		if (count[names[i]] > 1)
+			names[i].clear();
+	}
+	return names;
+}
+
+/**
+ * Entzerrt alle Eingabebilder mit dem Modell RadialDistortion(kappa) und
+ * schreibt sie nach outputDir, unter gleichem Dateinamen bzw. unter
+ * outputNames(), wenn Dateinamen in mehreren Verzeichnissen vorkommen. Für
+ * jede Bildgröße wird die UndistortMap nur einmal aufgebaut.
+ * Rückgabe: Anzahl der Bilder, die nicht gelesen, entzerrt oder geschrieben
+ * werden konnten (auch bei Ausnahmen oder doppelten Ausgabenamen).
+ */
+inline int runBatch(const std::vector<std::string> &files, const std::string &outputDir,
+		const std::vector<double> &kappa, UndistortMap::Interpolation interpolation, size_t queueLength = 8) {
+	BoundedQueue<BatchFrame> decoded(queueLength), undistorted(queueLength);
+	int failures = 0;
+	std::mutex failureMutex;
+	std::vector<std::string> names = outputNames(files);
+	RowBandExecutor executor;
+
+	// Ausnahmen dürfen die Threads nicht verlassen (sonst std::terminate)
+	std::thread decoder([&] {
+		for (size_t i = 0; i < files.size(); ++i) {
+			BatchFrame frame;
+			frame.name = names[i];
+			if (frame.name.empty()) {
+				std::lock_guard<std::mutex> lock(failureMutex);
+				std::cerr << "Output name of " << files[i] << " is not unique, skipped" << std::endl;
+				++failures;
+				continue;
+			}
+			std::string error;
+			try {
+				frame.image = cv::imread(files[i], CV_LOAD_IMAGE_COLOR);
+			} catch (const cv::Exception &e) {
+				error = e.what();
+			}
+			if (!frame.image.data) {
+				std::lock_guard<std::mutex> lock(failureMutex);
+				std::cerr << "Could not open or find the image " << files[i] << (error.empty() ? "" : ": ") << error << std::endl;
+				++failures;
+				continue;
+			}
+			decoded.push(std::move(frame));
+		}
+		decoded.close();
+	});
+
+	std::thread encoder([&] {
+		BatchFrame frame;
+		while (undistorted.pop(frame)) {
+			bool written = false;
+			std::string error;
+			try {
+				written = cv::imwrite(outputDir + "/" + frame.name, frame.image);
+			} catch (const cv::Exception &e) {
+				error = e.what();
+			}
+			if (!written) {
+				std::lock_guard<std::mutex> lock(failureMutex);
+				std::cerr << "Could not write " << outputDir << "/" << frame.name << (error.empty() ? "" : ": ") << error << std::endl;
+				++failures;
+			}
+		}
+	});
+
+	// auch hier darf keine Ausnahme durchschlagen: Dekoder und Kodierer
+	// liefen sonst beim Verlassen noch (std::terminate im Destruktor)
+	std::map<std::pair<int, int>, UndistortMap> maps;
+	BatchFrame frame;
+	while (decoded.pop(frame)) {
+		try {
+			std::pair<int, int> key(frame.image.cols, frame.image.rows);
+			std::map<std::pair<int, int>, UndistortMap>::iterator it = maps.find(key);
+			if (it == maps.end()) {
+				cv::Point2d center(frame.image.cols / 2, frame.image.rows / 2);
+				RadialDistortion distortion(kappa, center, std::sqrt(center.x * center.x + center.y * center.y) + 1);
+				it = maps.insert(std::make_pair(key, UndistortMap(distortion, frame.image.size(), interpolation))).first;
+			}
+			BatchFrame out;
+			out.name = frame.name;
+			it->second.apply(frame.image, out.image, executor);
+			undistorted.push(std::move(out));
+		} catch (const std::exception &e) {
+			std::lock_guard<std::mutex> lock(failureMutex);
+			std::cerr << "Could not undistort " << frame.name << ": " << e.what() << std::endl;
+			++failures;
+		}
+	}
+	decoded.close();
+	undistorted.close();
+
+	decoder.join();
+	encoder.join();
+	return failures;
+}
+
+#endif
@@ -10,11 +10,18 @@
 
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 #include <cmath>
 #include <cv.h>
 #include <highgui.h>
 
+#include "undistort.h"
+#include "batch.h"
+
 template<typename T> const T &min(const T &a, const T &b) { return a < b ? a : b; }
 template<typename T> const T &max(const T &a, const T &b) { return a > b ? a : b; }
 
@@ -28,11 +35,172 @@ template<typename T> const T &max(const T &a, const T &b) { return a > b ? a : b
  * \begin{center}\url{http://http://docs.opencv.org/modules/refman.html}\end{center}
  */
 
-int main(int argc, char *argv[]) {
-	if (argc < 5) {
-		printf("Usage: main <image-file-name> <output-file-name> <kappa1> <kappa2>\n\7");
-		exit(1);
+/**
+ * Aufrufhilfe; beendet das Programm.
+ */
+void usage() {
+	printf("Usage: main <image-file-name> <output-file-name> <kappa1> <kappa2> [nearest|bilinear|bicubic] [kappa3 ...]\n"
+	       "       main --bench <image-file-name> <kappa1> <kappa2> [frames]\n"
+	       "       main --scaling <image-file-name> <kappa1> <kappa2> [interpolation] [band-height]\n"
+	       "       main --batch <input-dir|glob> <output-dir> <kappa1> <kappa2> [interpolation] [kappa3 ...]\n\7");
+	exit(1);
+}
+
+/**
+ * Interpolationsart aus der Kommandozeile (nearest, bilinear, bicubic);
+ * bei unbekanntem Namen Abbruch mit der Aufrufhilfe.
+ */
+UndistortMap::Interpolation parseInterpolation(const std::string &name) {
+	if (name == "nearest")
+		return UndistortMap::NEAREST;
+	if (name == "bilinear")
+		return UndistortMap::BILINEAR;
+	if (name == "bicubic")
+		return UndistortMap::BICUBIC;
+	printf("Unknown interpolation '%s'\n", name.c_str());
+	usage();
+	return UndistortMap::NEAREST;
+}
+
+/**
+ * kappa1, kappa2 und optional weitere Koeffizienten höherer Ordnung.
+ */
+std::vector<double> parseKappa(const char *kappa1, const char *kappa2, int argc, char *argv[], int more) {
+	std::vector<double> kappa;
+	kappa.push_back(atof(kappa1));
+	kappa.push_back(atof(kappa2));
+	for (int i = more; i < argc; ++i)
+		kappa.push_back(atof(argv[i]));
+	return kappa;
+}
+
+/**
+ * Misst die Kosten pro Bild von undistortDirect und UndistortMap (für alle
+ * Interpolationsarten) bei 1080p und 4K.
+ * Aufruf: main --bench <image-file-name> <kappa1> <kappa2> [frames]
+ */
+int benchmark(int argc, char *argv[]) {
+	cv::Mat image = cv::imread(argv[2], CV_LOAD_IMAGE_COLOR);
+	if (!image.data) {
+		std::cout << "Could not open or find the image" << std::endl;
+		return -1;
+	}
+	double kappa1 = atof(argv[3]), kappa2 = atof(argv[4]);
+	int frames = argc > 5 ? atoi(argv[5]) : 10;
+
+	const cv::Size sizes[] = { cv::Size(1920, 1080), cv::Size(3840, 2160) };
+	const char *names[] = { "nearest", "bilinear", "bicubic" };
+	double ms = 1000.0 / cv::getTickFrequency();
+	for (int s = 0; s < 2; ++s) {
+		cv::Mat frame;
+		cv::resize(image, frame, sizes[s]);
+		cv::Point center(frame.cols / 2, frame.rows / 2);
+		// kappa auf die neue Auflösung umrechnen, damit die Verzerrung gleich bleibt
+		double scale = (double)image.cols / frame.cols;
+		double k1 = kappa1 * scale, k2 = kappa2 * scale * scale;
+		cv::Mat out;
+
+		int64 t0 = cv::getTickCount();
+		for (int i = 0; i < frames; ++i)
+			undistortDirect(frame, out, k1, k2, center);
+		int64 t1 = cv::getTickCount();
+		std::cout << frame.cols << "x" << frame.rows << ": direct " << (t1 - t0) * ms / frames << " ms/frame" << std::endl;
+
+		for (int m = UndistortMap::NEAREST; m <= UndistortMap::BICUBIC; ++m) {
+			int64 t2 = cv::getTickCount();
+			UndistortMap map(k1, k2, center, frame.size(), (UndistortMap::Interpolation)m);
+			int64 t3 = cv::getTickCount();
+			for (int i = 0; i < frames; ++i)
+				map.apply(frame, out);
+			int64 t4 = cv::getTickCount();
+			std::vector<cv::Mat> batch(frames, frame), batchOut;
+			map.apply(batch, batchOut);
+			int64 t5 = cv::getTickCount();
+
+			std::cout << "  " << names[m] << ": map build " << (t3 - t2) * ms
+				  << " ms, map " << (t4 - t3) * ms / frames
+				  << " ms/frame, batch " << (t5 - t4) * ms / frames << " ms/frame" << std::endl;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Skalierung der parallelen Entzerrung mit 1 bis N Threads auf einem auf 8K
+ * vergrößerten Bild; das Ergebnis wird mit dem einzelnen Thread verglichen.
+ * Aufruf: main --scaling <image-file-name> <kappa1> <kappa2> [interpolation] [band-height]
+ */
+int scaling(int argc, char *argv[]) {
+	cv::Mat image = cv::imread(argv[2], CV_LOAD_IMAGE_COLOR);
+	if (!image.data) {
+		std::cout << "Could not open or find the image" << std::endl;
+		return -1;
 	}
+	UndistortMap::Interpolation interpolation = parseInterpolation(argc > 5 ? argv[5] : "nearest");
+	int bandHeight = argc > 6 ? atoi(argv[6]) : 64;
+
+	cv::Mat frame;
+	cv::resize(image, frame, cv::Size(7680, 4320));
+	double scale = (double)image.cols / frame.cols;
+	cv::Point center(frame.cols / 2, frame.rows / 2);
+	UndistortMap map(atof(argv[3]) * scale, atof(argv[4]) * scale * scale, center, frame.size(), interpolation);
+
+	const int frames = 5;
+	double ms = 1000.0 / cv::getTickFrequency(), single = 0;
+	cv::Mat reference;
+	int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	for (int threads = 1; threads <= maxThreads; ++threads) {
+		RowBandExecutor executor(threads, bandHeight);
+		cv::Mat out;
+		map.apply(frame, out, executor);
+		int64 t0 = cv::getTickCount();
+		for (int i = 0; i < frames; ++i)
+			map.apply(frame, out, executor);
+		double t = (cv::getTickCount() - t0) * ms / frames;
+		if (threads == 1) {
+			single = t;
+			reference = out.clone();
+		}
+		bool same = true;
+		for (int y = 0; y < out.rows && same; ++y)
+			same = memcmp(out.ptr<uchar>(y), reference.ptr<uchar>(y), out.cols * out.elemSize()) == 0;
+		std::cout << threads << " threads: " << t << " ms/frame, speedup " << single / t
+			  << (same ? "" : " (MISMATCH)") << std::endl;
+	}
+	return 0;
+}
+
+/**
+ * Stapelbetrieb ohne Fenster und Tastaturabfragen.
+ * Aufruf: main --batch <input-dir|glob> <output-dir> <kappa1> <kappa2> [interpolation] [kappa3 ...]
+ */
+int batch(int argc, char *argv[]) {
+	std::vector<std::string> files = listInputs(argv[2]);
+	if (files.empty()) {
+		std::cout << "No input images found for " << argv[2] << std::endl;
+		return -1;
+	}
+	UndistortMap::Interpolation interpolation = parseInterpolation(argc > 6 ? argv[6] : "nearest");
+
+	int64 t0 = cv::getTickCount();
+	int failures = runBatch(files, argv[3], parseKappa(argv[4], argv[5], argc, argv, 7), interpolation);
+	double seconds = (cv::getTickCount() - t0) / cv::getTickFrequency();
+
+	std::cout << files.size() - failures << " of " << files.size() << " images in " << seconds
+		  << " s (" << (files.size() - failures) / seconds << " images/s)" << std::endl;
+	return failures ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc >= 5 && std::string(argv[1]) == "--bench")
+		return benchmark(argc, argv);
+	if (argc >= 5 && std::string(argv[1]) == "--scaling")
+		return scaling(argc, argv);
+	if (argc >= 6 && std::string(argv[1]) == "--batch")
+		return batch(argc, argv);
+
+	if (argc < 5)
+		usage();
 
 	/**
 	 * Aufgabe: OpenCV starten (10 Punkte)
@@ -143,28 +311,20 @@ int main(int argc, char *argv[]) {
 	 *   wobei das Verzerrungszentrum der Bildmitte entspricht.
 	 */
 
-	std::stringstream sstr;
-	sstr << argv[3] << argv[4];
-
-	double kappa1, kappa2;
-	sstr >> kappa1 >> kappa2;
-
-	//std::cout << kappa1 << std::endl;
-	//std::cout << kappa2 << std::endl;
-
-	cv::Mat undistorted_image(image.size(), image.type());
-	for ( int x = 0; x < image.cols; x++) {
-		for (int y = 0; y < image.rows; y++) {
-			double r = sqrt(pow(x - center.x,2) + pow(y - center.y, 2));
-			double l_r = 1 + kappa1*r + kappa2*pow(r,2)/* + argv[5]*pow(r,3)*/; //nur 2. Ordnung...
-			int x_new = center.x + (x-center.x) / l_r;
-			int y_new = center.y + (y-center.y) / l_r;
-			if (x_new < 0 || y_new < 0 || x_new >= image.cols || y_new >= image.rows)
-				continue;
-			cv::Vec3b color = image.at<cv::Vec3b>(cv::Point(x_new,y_new)); //pixel color from distorted image
-			undistorted_image.at<cv::Vec3b>(cv::Point(x,y)) = color;
-		}
-	}
+	std::vector<double> kappa = parseKappa(argv[3], argv[4], argc, argv, 6);
+
+	/**
+	 * Die Umkehrabbildung (unverzerrt -> verzerrt) wird einmal per
+	 * Newton-Verfahren als radiale Tabelle berechnet; beliebig viele
+	 * Koeffizienten $\kappa_3, \kappa_4, \ldots$ können angehängt werden.
+	 */
+	double maxRadius = sqrt(pow(center.x, 2) + pow(center.y, 2)) + 1;
+	RadialDistortion distortion(kappa, cv::Point2d(center.x, center.y), maxRadius);
+	UndistortMap::Interpolation interpolation = parseInterpolation(argc > 5 ? argv[5] : "nearest");
+	UndistortMap undistortMap(distortion, image.size(), interpolation);
+	RowBandExecutor executor;
+	cv::Mat undistorted_image;
+	undistortMap.apply(image, undistorted_image, executor);
 	/* TODO */
 	cv::namedWindow( "Deskewed", cv::WINDOW_AUTOSIZE );
 	cv::moveWindow( "Deskewed", 100, 100);	
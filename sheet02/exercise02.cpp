@@ -8,16 +8,116 @@
  * URL: http://www.cg.cs.tu-bs.de/teaching/lectures/ss15/bbm/
  */
 
+#include <cstdlib>
 #include <iostream>
+#include <string>
+#include <vector>
 #include <cv.h>
 #include <highgui.h>
 
+#include "../common/canny.h"
+#include "../common/imagepool.h"
+#include "gaussian.h"
+#include "harris.h"
+
 /**
 * http://stackoverflow.com/questions/22590907/cvsmooth-identifier-not-found ...
 * http://answers.opencv.org/question/17546/opencv-will-drop-c-api-support-soon/
 */
 
+/**
+ * Harris-Antwort und Anzahl der Ecken für mehrere Fenstergrößen, alle aus
+ * einem Satz Integralbilder (Standard: 3, 5, ..., 31).
+ * Aufruf: main --windows <image-file-name> [window...]
+ */
+int windowSweep(int argc, char **argv) {
+	cv::Mat image = cv::imread(argv[2], CV_LOAD_IMAGE_GRAYSCALE);
+	if (!image.data) {
+		std::cerr << "Could not open or find the image" << std::endl;
+		return -1;
+	}
+	cv::Mat gray;
+	image.convertTo(gray, CV_32F, 1.0 / 255.0);
+
+	std::vector<int> windows;
+	for (int i = 3; i < argc; ++i)
+		windows.push_back(atoi(argv[i]));
+	if (windows.empty()) {
+		for (int w = 3; w <= 31; w += 2)
+			windows.push_back(w);
+	}
+	for (size_t i = 0; i < windows.size(); ++i) {
+		if (windows[i] < 1 || windows[i] % 2 == 0) {
+			std::cerr << "window sizes must be odd" << std::endl;
+			return -1;
+		}
+	}
+
+	double ms = 1000.0 / cv::getTickFrequency();
+	int64 t0 = cv::getTickCount();
+	StructureTensorIntegral tensor(gray);
+	std::cout << "integral images: " << (cv::getTickCount() - t0) * ms << " ms" << std::endl;
+	cv::Mat R;
+	for (size_t i = 0; i < windows.size(); ++i) {
+		int64 t1 = cv::getTickCount();
+		tensor.response(windows[i], HARRIS_RESPONSE, 0.04, R);
+		int64 t2 = cv::getTickCount();
+		std::vector<Peak> corners = nonMaxSuppression(R, 0.1f);
+		std::cout << "window " << windows[i] << ": " << corners.size() << " corners, response "
+			  << (t2 - t1) * ms << " ms" << std::endl;
+	}
+	return 0;
+}
+
+/**
+ * Kanten- und Eckendetektion als Schleife über dasselbe Bild, ohne GUI. Alle
+ * Bildpuffer kommen aus einem ImagePool, EdgeDetector und HarrisDetector
+ * halten ihre Zeilenpuffer selbst; ab dem zweiten Durchlauf sollte kein
+ * Puffer mehr angelegt werden.
+ * Aufruf: main --frames <image-file-name> [frames]
+ */
+int frameLoop(int argc, char **argv) {
+	cv::Mat image = cv::imread(argv[2], CV_LOAD_IMAGE_COLOR);
+	if (!image.data) {
+		std::cerr << "Could not open or find the image" << std::endl;
+		return -1;
+	}
+	int frames = argc > 3 ? atoi(argv[3]) : 20;
+
+	ImagePool pool;
+	EdgeDetector edgeDetector;
+	HarrisDetector harris;
+	std::vector<Peak> corners;
+	double ms = 1000.0 / cv::getTickFrequency();
+	for (int i = 0; i < frames; ++i) {
+		size_t allocations = pool.stats().allocations;
+		int64 t0 = cv::getTickCount();
+		cv::Mat grayU8 = pool.acquire(image.size(), CV_8UC1);
+		cv::Mat gray = pool.acquire(image.size(), CV_32FC1);
+		cv::Mat weak = pool.acquire(image.size(), CV_8UC1);
+		cv::Mat strong = pool.acquire(image.size(), CV_8UC1);
+		cv::Mat edges = pool.acquire(image.size(), CV_8UC1);
+		cv::cvtColor(image, grayU8, CV_BGR2GRAY);
+		grayU8.convertTo(gray, CV_32F, 1.0 / 255.0);
+		edgeDetector.detect(grayU8, -1, -1, weak, strong, edges);
+		harris.detect(gray, 0.04, 0.1, 3, HARRIS_BOX, PeakSelection(1, 500), corners);
+		pool.recycle();
+		std::cout << "frame " << i << ": " << (cv::getTickCount() - t0) * ms << " ms, "
+			  << corners.size() << " corners, " << pool.stats().allocations - allocations
+			  << " buffer allocations" << std::endl;
+	}
+	const ImagePoolStats &stats = pool.stats();
+	std::cout << "peak " << stats.peakInUseBytes / 1024 << " KiB in use, steady state "
+		  << stats.reservedBytes / 1024 << " KiB reserved, " << stats.allocations << " buffers" << std::endl;
+	return 0;
+}
+
 int main(int argc, char **argv) {
+	if (argc >= 3 && std::string(argv[1]) == "--windows")
+		return windowSweep(argc, argv);
+	if (argc >= 3 && std::string(argv[1]) == "--frames")
+		return frameLoop(argc, argv);
+
 	/**
 	 * Aufgabe: 2D-Operationen auf Bildern (5 Punkte)
 	 *
@@ -40,12 +140,20 @@ int main(int argc, char **argv) {
 
 	if (argc < 2) {
 		std::cerr << "usage: " << argv[0] << " <image>" << std::endl;
+		std::cerr << "       " << argv[0] << " --windows <image> [window...]" << std::endl;
+		std::cerr << "       " << argv[0] << " --frames <image> [frames]" << std::endl;
 		exit(1);
 	}
 	IplImage *image = cvLoadImage(argv[1]);
+	if (!image) {
+		std::cerr << "Could not open or find the image" << std::endl;
+		exit(1);
+	}
 	CvSize size = cvGetSize(image);
-	IplImage *imageFloat = cvCreateImage(size, IPL_DEPTH_32F, image->nChannels);
-	IplImage *gray = cvCreateImage(size, IPL_DEPTH_32F, 1);
+	// alle Zwischenbilder kommen aus dem Pool und werden am Ende zurückgegeben
+	ImagePool pool;
+	IplImage *imageFloat = pool.acquireImage(size, IPL_DEPTH_32F, image->nChannels);
+	IplImage *gray = pool.acquireImage(size, IPL_DEPTH_32F, 1);
 
 /* TODO */
 	cvConvertScale(image, imageFloat, 1.0 / 255.0);
@@ -59,15 +167,17 @@ int main(int argc, char **argv) {
 	 * - Falte ein verrauschtes Testbild mit Gaußfunktionen verschiedener
 	 *   Varianzen. Was passiert? Welchen Einfluss hat die Kernelgröße?
 	 */
-	IplImage *lgauss = cvCreateImage(size, IPL_DEPTH_32F, 1);
-	IplImage *sgauss = cvCreateImage(size, IPL_DEPTH_32F, 1);
+	IplImage *lgauss = pool.acquireImage(size, IPL_DEPTH_32F, 1);
+	IplImage *sgauss = pool.acquireImage(size, IPL_DEPTH_32F, 1);
 
 /* TODO */
-	int kernel_size = 201;
+	// die Kernelgröße ergibt sich aus sigma, große sigma laufen rekursiv (gaussian.h)
 	float sigma_s = 2;
 	float sigma_l = 20;
-	cvSmooth(gray, sgauss, CV_GAUSSIAN, kernel_size, kernel_size, sigma_s);
-	cvSmooth(gray, lgauss, CV_GAUSSIAN, kernel_size, kernel_size, sigma_l);
+	cv::Mat grayMat(gray), sgaussMat(sgauss), lgaussMat(lgauss);
+	gaussianBlur(grayMat, sgaussMat, sigma_s);
+	// G(sigma_l) = G(sqrt(sigma_l^2 - sigma_s^2)) * G(sigma_s): das große sigma baut auf dem kleinen auf
+	gaussianBlur(sgaussMat, lgaussMat, sqrt(sigma_l*sigma_l - sigma_s*sigma_s));
 
 	cvNamedWindow("Large Gaussian"); 
 	cvShowImage("Large Gaussian", lgauss);
@@ -79,7 +189,7 @@ int main(int argc, char **argv) {
 	 * - Betrachte die Differenzen zweier gaußgefilterter Bilder (evt.
 	 *   skalieren).
 	 */
-	IplImage *dog = cvCreateImage(size, IPL_DEPTH_32F, 1);
+	IplImage *dog = pool.acquireImage(size, IPL_DEPTH_32F, 1);
 
 /* TODO */
 	cvAbsDiff(lgauss, sgauss, dog);
@@ -111,22 +221,20 @@ int main(int argc, char **argv) {
 
 /* TODO */
 	float kernel[] = { -10.0, 0, 10.0 };
-	CvMat *filterDx = cvCreateMatHeader(1, 3, CV_32FC1);
-	CvMat *filterDy = cvCreateMatHeader(3, 1, CV_32FC1);
-	cvSetData(filterDx, kernel, filterDx->step);
-	cvSetData(filterDy, kernel, filterDy->step);
+	CvMat filterDx = cvMat(1, 3, CV_32FC1, kernel);
+	CvMat filterDy = cvMat(3, 1, CV_32FC1, kernel);
 
 	/**
 	 * - Implementiere diskretes Differenzieren als Faltung mit diesem Kern und
 	 *   wende es auf ein glattes Testbild an.  Was passiert, wenn du ein
 	 *   verrauschtes Testbild verwendest?
 	 */
-	IplImage *dx = cvCreateImage(size, IPL_DEPTH_32F, 1);
-	IplImage *dy = cvCreateImage(size, IPL_DEPTH_32F, 1);
+	IplImage *dx = pool.acquireImage(size, IPL_DEPTH_32F, 1);
+	IplImage *dy = pool.acquireImage(size, IPL_DEPTH_32F, 1);
 
 /* TODO */
-	cvFilter2D(gray, dx, filterDx);
-	cvFilter2D(gray, dy, filterDy);
+	cvFilter2D(gray, dx, &filterDx);
+	cvFilter2D(gray, dy, &filterDy);
 
 	cvNamedWindow("DX"); 
 	cvShowImage("DX", dx);
@@ -139,7 +247,7 @@ int main(int argc, char **argv) {
 	 *   (\code{cvSobel}) und beobachte die Ergebnisse auf dem verrauschten
 	 *   Testbild.
 	 */
-	IplImage *sobel = cvCreateImage(size, IPL_DEPTH_32F, 1);
+	IplImage *sobel = pool.acquireImage(size, IPL_DEPTH_32F, 1);
 
 /* TODO */
 	cvSobel(gray, sobel, 1, 0);
@@ -157,27 +265,26 @@ int main(int argc, char **argv) {
 	 *   Schwellwerte des Gradienten, um möglichst alle Kanten zu entdecken
 	 *   oder möglichst nur Kanten zu entdecken.
 	 */
-	IplImage* gradient = cvCreateImage(size, IPL_DEPTH_32F, 1);
+	IplImage* gradient = pool.acquireImage(size, IPL_DEPTH_32F, 1);
+	IplImage* edge1 = pool.acquireImage(size, IPL_DEPTH_8U, 1);
+	IplImage* edge2 = pool.acquireImage(size, IPL_DEPTH_8U, 1);
+	IplImage* edge = pool.acquireImage(size, IPL_DEPTH_8U, 1);
 
 /* TODO */
-	IplImage *dxx = cvCreateImage(size, IPL_DEPTH_32F, 1);
-	IplImage *dyy = cvCreateImage(size, IPL_DEPTH_32F, 1);
-	cvMul(dx, dx, dxx);
-	cvMul(dy, dy, dyy);
-
-	cvAdd(dxx, dyy, gradient);
+	// ein Sobel-Gradient (int16) für beide Schwellwertbilder und Canny,
+	// Schwellen aus dem Histogramm der Gradientenbeträge (canny.h)
+	IplImage* gray_u8 = pool.acquireImage(size, IPL_DEPTH_8U, 1);
+	cvCvtColor(image, gray_u8, CV_BGR2GRAY);
+	EdgeDetector edgeDetector;
+	cv::Mat grayU8Mat(gray_u8), edge1Mat(edge1), edge2Mat(edge2), edgeMat(edge), gradientMat(gradient);
+	edgeDetector.detect(grayU8Mat, -1, -1, edge1Mat, edge2Mat, edgeMat);
+	edgeDetector.gradientMagnitude().convertTo(gradientMat, CV_32F, 1.0 / EdgeDetector::MAX_MAGNITUDE);
+	int t1 = edgeDetector.lowThreshold(), t2 = edgeDetector.highThreshold();
+	std::cout << "edge thresholds: " << t1 << ", " << t2 << std::endl;
 
 	cvShowImage("Gradient", gradient);
 	cvWaitKey(0);
 
-	IplImage* edge1 = cvCreateImage(size, IPL_DEPTH_8U, 1);
-	IplImage* edge2 = cvCreateImage(size, IPL_DEPTH_8U, 1);
-
-/* TODO */
-	int t1 = 1, t2 = 10;
-	cvCmpS(gradient, t1, edge1, CV_CMP_GT);
-	cvCmpS(gradient, t2, edge2, CV_CMP_GT);
-
 	cvShowImage("All edges", edge1);
 	cvWaitKey(0);
 	cvShowImage("Only edges", edge2);
@@ -187,13 +294,9 @@ int main(int argc, char **argv) {
 	 * - Vergleiche mit dem Ergebnis des Canny-Kantendetektors
 	 *   (\code{cvCanny}), wenn er mit diesen Parametern aufgerufen wird.
 	 */
-	IplImage* edge = cvCreateImage(size, IPL_DEPTH_8U, 1);
 
 /* TODO */
-	IplImage* gray_u8 = cvCreateImage(size, IPL_DEPTH_8U, 1);
-	cvCvtColor(image, gray_u8, CV_BGR2GRAY);
-	cvCanny(gray_u8, edge, t1, t2, 3);
-
+	// Canny mit t1, t2 entstand bereits oben aus demselben Gradienten
 	cvShowImage("Canny", edge);
 	cvWaitKey(0);
 
@@ -208,73 +311,9 @@ int main(int argc, char **argv) {
 	 *   Ausschlag des Indikators entgegennimmt und die Featurepunkte
 	 *   zurückgibt.
 	 */
-	std::vector<CvPoint> harris_pts;
-
-/* TODO */
-    IplImage* i_xx = cvCreateImage(size,IPL_DEPTH_32F,1);
-    IplImage* i_yy = cvCreateImage(size,IPL_DEPTH_32F,1);
-    IplImage* i_xy = cvCreateImage(size,IPL_DEPTH_32F,1);
-	
-    cvSobel(gray,dx,1,0,3);
-    cvSobel(gray,dy,0,1,3);
-
-    cvMul(dx,dx,i_xx,1);
-    cvMul(dy,dy,i_yy,1);
-    cvMul(dx,dy,i_xy,1);
-
-	//or 5?
-	cvSmooth(i_xx, i_xx, CV_BLUR, 3, 3);
-	cvSmooth(i_yy, i_yy, CV_BLUR, 3, 3);
-	cvSmooth(i_xy, i_xy, CV_BLUR, 3, 3);
-
 	double k = 0.04, omega = 0.1;
-
-	/*
-		Response function
-		R = det A − k(trace A)^2
-		So with OpenCv it should be: Ixx * Iyy - Ixy^2 - k*(Ixx+Iyy)^2
-	*/
-	CvMat* R = cvCreateMat(size.height,size.width,CV_32FC1);
-	cvMul(i_xx, i_yy, R);
-	cvMul(i_xy, i_xy, i_xy); //i_xy is now i_xy^2
-	cvSub(R, i_xy, R);
-
-	CvMat* trace = cvCreateMat(size.height,size.width,CV_32FC1);
-	cvAdd(i_xx, i_yy, trace);
-	cvMul(trace, trace, trace, k);
-
-    cvSub(R, trace, R);
-
-    for(int x = 1; x < size.width-1; x++){
-        for(int y=1; y < size.height-1; y++){
-
-            float r = CV_MAT_ELEM((*R),float,y,x);
-
-			// r < 0 -> Edge
-			// r > 0 -> Corner
-			// |r| small -> flat
-
-			/*
-			The Algorithm:
-				– Find points with large corner response
-				  function R (R > threshold)
-				– Take the points of local maxima of R
-			*/
-
-            if(r>omega){
-				bool localMaximum = true;
-				for(int u=-1; u<2; ++u) {
-					for(int v=-1; v<2; ++v) {
-						if(v==0 && u==0) continue;
-						localMaximum &= (r > CV_MAT_ELEM((*R),float,y+u,x+v));
-					}
-				}
-				if(localMaximum) {
-					harris_pts.push_back(cvPoint(x,y));
-				} 
-            }
-        }
-    }
+	// Gradienten, Strukturtensor (3x3 Box), Antwort R und NMS in einem Durchlauf
+	std::vector<Peak> harris_pts = harrisCorners(grayMat, k, omega, 3);
 
 	/**
 	 * - Zeichne ein $3\times3$ Rechteck um jede gefundene Harris-Corner.
@@ -283,12 +322,20 @@ int main(int argc, char **argv) {
 /* TODO */
 
 	for (int j = 0; j<harris_pts.size();j++){
-        int x = harris_pts[j].x;
-        int y = harris_pts[j].y;
+        int x = harris_pts[j].pt.x;
+        int y = harris_pts[j].pt.y;
         cvRectangle(image, cvPoint(1+x, 1+y) , cvPoint(-1+x,-1+y) , cvScalar(0, 0, 255, 0), 1, 8, 0);
     }
 
 	cvShowImage("Harris Corners", image);
 	cvWaitKey(0);
+
+	const ImagePoolStats &stats = pool.stats();
+	std::cout << "image pool: " << stats.allocations << " buffers, peak "
+		  << stats.peakInUseBytes / 1024 << " KiB" << std::endl;
+	pool.recycle();
+	cvReleaseImage(&image);
+	cvDestroyAllWindows();
+	return 0;
 }
 
@@ -0,0 +1,220 @@
+/**
+ * Gaußfilter für einkanalige float-Bilder (CV_32FC1).
+ *
+ * Die Kernelgröße folgt aus sigma (2 * ceil(3 sigma) + 1). Kleine sigma
+ * werden separabel als FIR-Filter gefaltet (SSE), große mit dem rekursiven
+ * Filter von Young und van Vliet, dessen Kosten pro Pixel nicht von sigma
+ * abhängen. Am Rand wird das Bild fortgesetzt (Randwiederholung).
+ */
+
+#ifndef GAUSSIAN_H
+#define GAUSSIAN_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <cv.h>
+
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#endif
+
+/**
+ * Ab diesem sigma wird der rekursive Filter verwendet; darunter ist die
+ * Faltung günstig und genauer (Abweichung des rekursiven Filters < 1% ab 5).
+ */
+const double GAUSSIAN_IIR_SIGMA = 5.0;
+
+inline int gaussianKernelSize(double sigma) {
+	return 2 * (int)std::ceil(3 * sigma) + 1;
+}
+
+/**
+ * Normierter eindimensionaler Kern der Länge gaussianKernelSize(sigma).
+ */
+inline std::vector<float> gaussianKernel(double sigma) {
+	int size = gaussianKernelSize(sigma), radius = size / 2;
+	std::vector<float> kernel(size);
+	double sum = 0;
+	for (int i = 0; i < size; ++i) {
+		double d = i - radius;
+		kernel[i] = (float)std::exp(-d*d / (2*sigma*sigma));
+		sum += kernel[i];
+	}
+	for (int i = 0; i < size; ++i)
+		kernel[i] = (float)(kernel[i] / sum);
+	return kernel;
+}
+
+/**
+ * Separable Faltung: erst zeilenweise in ein Zwischenbild, dann spaltenweise
+ * (vektorisiert über 4 Spalten) nach dst. src und dst dürfen gleich sein.
+ */
+inline void gaussianBlurFIR(const cv::Mat &src, cv::Mat &dst, double sigma) {
+	std::vector<float> kernel = gaussianKernel(sigma);
+	int radius = (int)kernel.size() / 2, width = src.cols, height = src.rows;
+	const float *k = &kernel[radius];
+
+	cv::Mat tmp(src.size(), CV_32FC1);
+	std::vector<float> padded(width + 2 * radius);
+	for (int y = 0; y < height; ++y) {
+		const float *s = src.ptr<float>(y);
+		std::fill(padded.begin(), padded.begin() + radius, s[0]);
+		std::copy(s, s + width, padded.begin() + radius);
+		std::fill(padded.begin() + radius + width, padded.end(), s[width - 1]);
+
+		const float *p = &padded[radius];
+		float *t = tmp.ptr<float>(y);
+		int x = 0;
+#if defined(__SSE2__)
+		for (; x + 4 <= width; x += 4) {
+			__m128 sum = _mm_mul_ps(_mm_loadu_ps(p + x), _mm_set1_ps(k[0]));
+			for (int i = 1; i <= radius; ++i) {
+				__m128 pair = _mm_add_ps(_mm_loadu_ps(p + x - i), _mm_loadu_ps(p + x + i));
+				sum = _mm_add_ps(sum, _mm_mul_ps(pair, _mm_set1_ps(k[i])));
+			}
+			_mm_storeu_ps(t + x, sum);
+		}
+#endif
+		for (; x < width; ++x) {
+			float sum = p[x] * k[0];
+			for (int i = 1; i <= radius; ++i)
+				sum += (p[x - i] + p[x + i]) * k[i];
+			t[x] = sum;
+		}
+	}
+
+	dst.create(src.size(), CV_32FC1);
+	std::vector<const float *> rows(2 * radius + 1);
+	for (int y = 0; y < height; ++y) {
+		for (int i = -radius; i <= radius; ++i)
+			rows[i + radius] = tmp.ptr<float>(std::min(std::max(y + i, 0), height - 1));
+		const float *const *r = &rows[radius];
+		float *d = dst.ptr<float>(y);
+		int x = 0;
+#if defined(__SSE2__)
+		for (; x + 4 <= width; x += 4) {
+			__m128 sum = _mm_mul_ps(_mm_loadu_ps(r[0] + x), _mm_set1_ps(k[0]));
+			for (int i = 1; i <= radius; ++i) {
+				__m128 pair = _mm_add_ps(_mm_loadu_ps(r[-i] + x), _mm_loadu_ps(r[i] + x));
+				sum = _mm_add_ps(sum, _mm_mul_ps(pair, _mm_set1_ps(k[i])));
+			}
+			_mm_storeu_ps(d + x, sum);
+		}
+#endif
+		for (; x < width; ++x) {
+			float sum = r[0][x] * k[0];
+			for (int i = 1; i <= radius; ++i)
+				sum += (r[-i][x] + r[i][x]) * k[i];
+			d[x] = sum;
+		}
+	}
+}
+
+/**
+ * Koeffizienten des rekursiven Gaußfilters 3. Ordnung
+ * (Young, van Vliet: Recursive implementation of the Gaussian filter, 1995),
+ * bereits durch b0 geteilt.
+ */
+struct RecursiveGaussian {
+	float B, b1, b2, b3;
+
+	explicit RecursiveGaussian(double sigma) {
+		double q = sigma >= 2.5 ? 0.98711 * sigma - 0.96330
+		                        : 3.97156 - 4.14554 * std::sqrt(1 - 0.26891 * std::max(sigma, 0.5));
+		double b0 = 1.57825 + 2.44413*q + 1.4281*q*q + 0.422205*q*q*q;
+		b1 = (float)((2.44413*q + 2.85619*q*q + 1.26661*q*q*q) / b0);
+		b2 = (float)(-(1.4281*q*q + 1.26661*q*q*q) / b0);
+		b3 = (float)(0.422205*q*q*q / b0);
+		B = 1 - (b1 + b2 + b3);
+	}
+};
+
+/**
+ * Rekursiver Filter, in-place auf dst: vorwärts und rückwärts entlang jeder
+ * Zeile, dann entlang der Spalten, wobei alle Spalten einer Zeile gemeinsam
+ * (vektorisierbar) aktualisiert werden.
+ */
+inline void gaussianBlurIIR(const cv::Mat &src, cv::Mat &dst, double sigma) {
+	RecursiveGaussian g(sigma);
+	int width = src.cols, height = src.rows;
+	if (dst.data != src.data)
+		src.copyTo(dst);
+
+	for (int y = 0; y < height; ++y) {
+		float *d = dst.ptr<float>(y);
+		float w1 = d[0], w2 = d[0], w3 = d[0];
+		for (int x = 0; x < width; ++x) {
+			float w = g.B * d[x] + g.b1 * w1 + g.b2 * w2 + g.b3 * w3;
+			w3 = w2; w2 = w1; w1 = w;
+			d[x] = w;
+		}
+		w1 = w2 = w3 = d[width - 1];
+		for (int x = width - 1; x >= 0; --x) {
+			float w = g.B * d[x] + g.b1 * w1 + g.b2 * w2 + g.b3 * w3;
+			w3 = w2; w2 = w1; w1 = w;
+			d[x] = w;
+		}
+	}
+
+	// Zustand der letzten drei Zeilen pro Spalte
+	std::vector<float> s1(width), s2(width), s3(width);
+	const float *first = dst.ptr<float>(0);
+	std::copy(first, first + width, s1.begin());
+	s2 = s1; s3 = s1;
+	for (int y = 0; y < height; ++y) {
+		float *d = dst.ptr<float>(y);
+		for (int x = 0; x < width; ++x) {
+			float w = g.B * d[x] + g.b1 * s1[x] + g.b2 * s2[x] + g.b3 * s3[x];
+			s3[x] = s2[x]; s2[x] = s1[x]; s1[x] = w;
+			d[x] = w;
+		}
+	}
+	const float *last = dst.ptr<float>(height - 1);
+	std::copy(last, last + width, s1.begin());
+	s2 = s1; s3 = s1;
+	for (int y = height - 1; y >= 0; --y) {
+		float *d = dst.ptr<float>(y);
+		for (int x = 0; x < width; ++x) {
+			float w = g.B * d[x] + g.b1 * s1[x] + g.b2 * s2[x] + g.b3 * s3[x];
+			s3[x] = s2[x]; s2[x] = s1[x]; s1[x] = w;
+			d[x] = w;
+		}
+	}
+}
+
+/**
+ * Gaußfilter mit automatisch gewähltem Verfahren.
+ */
+inline void gaussianBlur(const cv::Mat &src, cv::Mat &dst, double sigma) {
+	CV_Assert(src.type() == CV_32FC1);
+	if (sigma <= 0) {
+		if (dst.data != src.data)
+			src.copyTo(dst);
+		return;
+	}
+	if (sigma < GAUSSIAN_IIR_SIGMA)
+		gaussianBlurFIR(src, dst, sigma);
+	else
+		gaussianBlurIIR(src, dst, sigma);
+}
+
+/**
+ * Difference of Gaussians. Das große sigma wird aus dem bereits geglätteten
+ * Bild erzeugt: G(sigmaLarge) = G(sqrt(sigmaLarge^2 - sigmaSmall^2)) * G(sigmaSmall).
+ */
+inline void differenceOfGaussians(const cv::Mat &src, double sigmaSmall, double sigmaLarge,
+		cv::Mat &small, cv::Mat &large, cv::Mat &dog) {
+	CV_Assert(sigmaLarge >= sigmaSmall);
+	gaussianBlur(src, small, sigmaSmall);
+	gaussianBlur(small, large, std::sqrt(sigmaLarge*sigmaLarge - sigmaSmall*sigmaSmall));
+	dog.create(src.size(), CV_32FC1);
+	for (int y = 0; y < src.rows; ++y) {
+		const float *s = small.ptr<float>(y), *l = large.ptr<float>(y);
+		float *d = dog.ptr<float>(y);
+		for (int x = 0; x < src.cols; ++x)
+			d[x] = std::fabs(l[x] - s[x]);
+	}
+}
+
+#endif
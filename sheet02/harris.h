@@ -0,0 +1,298 @@
+/**
+ * Harris-Corner-Detektor in einem Durchlauf über das Bild.
+ *
+ * Statt Gradienten, Strukturtensor, Fensterung und Antwortfunktion jeweils als
+ * ganze Bilder zu berechnen, wird Zeile für Zeile gearbeitet: die gefensterten
+ * Produkte liegen in einem Ringpuffer aus window + 1 Zeilen, die Antwort R in
+ * einem Ringpuffer aus 2 radius + 1 Zeilen, auf dem direkt die
+ * Nicht-Maximum-Unterdrückung (nms.h) läuft. Der Speicherbedarf hängt nur von
+ * der Bildbreite ab; HarrisDetector hält diese Puffer über eine Bildfolge.
+ */
+
+#ifndef HARRIS_H
+#define HARRIS_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <cv.h>
+
+#include "../common/nms.h"
+
+enum HarrisWindow { HARRIS_BOX, HARRIS_GAUSSIAN };
+
+namespace harris_detail {
+
+inline int clampIndex(int i, int n) {
+	return std::min(std::max(i, 0), n - 1);
+}
+
+/**
+ * Gewichte des Fensters (Box wie cvSmooth(CV_BLUR) oder Gauß), Summe 1.
+ */
+inline void windowWeights(int window, HarrisWindow type, std::vector<float> &w) {
+	w.assign(window, 1.0f / window);
+	if (type == HARRIS_GAUSSIAN) {
+		// sigma aus der Fenstergröße wie bei cv::getGaussianKernel
+		double sigma = 0.3 * ((window - 1) * 0.5 - 1) + 0.8, sum = 0;
+		for (int i = 0; i < window; ++i) {
+			double d = i - window / 2;
+			w[i] = (float)std::exp(-d*d / (2*sigma*sigma));
+			sum += w[i];
+		}
+		for (int i = 0; i < window; ++i)
+			w[i] = (float)(w[i] / sum);
+	}
+}
+
+/**
+ * Sobel (3x3, Randwiederholung) für Zeile y und Produkte des Strukturtensors.
+ */
+inline void tensorProductsRow(const cv::Mat &gray, int y, float *xx, float *yy, float *xy) {
+	int width = gray.cols;
+	const float *up = gray.ptr<float>(clampIndex(y - 1, gray.rows));
+	const float *mid = gray.ptr<float>(y);
+	const float *down = gray.ptr<float>(clampIndex(y + 1, gray.rows));
+	for (int x = 0; x < width; ++x) {
+		int l = x > 0 ? x - 1 : 0, r = x < width - 1 ? x + 1 : width - 1;
+		float dx = (up[r] - up[l]) + 2 * (mid[r] - mid[l]) + (down[r] - down[l]);
+		float dy = (down[l] + 2 * down[x] + down[r]) - (up[l] + 2 * up[x] + up[r]);
+		xx[x] = dx * dx;
+		yy[x] = dy * dy;
+		xy[x] = dx * dy;
+	}
+}
+
+/**
+ * Produkte des Strukturtensors für Zeile y mit horizontaler Fensterung,
+ * Ergebnis in xx, yy, xy (je width Werte).
+ */
+inline void windowedTensorRow(const cv::Mat &gray, int y, const std::vector<float> &weights,
+		std::vector<float> &ixx, std::vector<float> &iyy, std::vector<float> &ixy,
+		float *xx, float *yy, float *xy) {
+	int width = gray.cols, r = (int)weights.size() / 2;
+
+	// Produkte mit r Pixeln Rand links und rechts (Randwiederholung)
+	float *pxx = &ixx[r], *pyy = &iyy[r], *pxy = &ixy[r];
+	tensorProductsRow(gray, y, pxx, pyy, pxy);
+	for (int i = 1; i <= r; ++i) {
+		pxx[-i] = pxx[0]; pyy[-i] = pyy[0]; pxy[-i] = pxy[0];
+		pxx[width - 1 + i] = pxx[width - 1]; pyy[width - 1 + i] = pyy[width - 1]; pxy[width - 1 + i] = pxy[width - 1];
+	}
+
+	for (int x = 0; x < width; ++x) {
+		float sxx = 0, syy = 0, sxy = 0;
+		for (int i = -r; i <= r; ++i) {
+			float w = weights[i + r];
+			sxx += w * pxx[x + i];
+			syy += w * pyy[x + i];
+			sxy += w * pxy[x + i];
+		}
+		xx[x] = sxx;
+		yy[x] = syy;
+		xy[x] = sxy;
+	}
+}
+
+}
+
+/**
+ * Harris-Detektor für Bildfolgen: Ringpuffer, Antwortzeilen und die Auswahl
+ * der Maxima bleiben als Mitglieder erhalten, so dass ab dem zweiten Bild
+ * gleicher Größe kein Speicher mehr angelegt wird.
+ */
+class HarrisDetector {
+public:
+	/**
+	 * Schreibt nach corners die Punkte mit R = det A - k (trace A)^2 >
+	 * threshold, die im Nachbarschaftsfenster der Größe 2 selection.radius + 1
+	 * maximal sind (nms.h), ausgewählt gemäß selection. window ist die
+	 * (ungerade) Fenstergröße für die Summation des Strukturtensors.
+	 */
+	void detect(const cv::Mat &gray, double k, double threshold, int window, HarrisWindow type,
+			const PeakSelection &selection, std::vector<Peak> &corners) {
+		using namespace harris_detail;
+		CV_Assert(gray.type() == CV_32FC1 && window % 2 == 1 && selection.radius >= 1);
+		int width = gray.cols, height = gray.rows, r = window / 2, radius = selection.radius;
+		collector.reset(gray.size(), selection);
+		if (width <= 2 * radius || height <= 2 * radius) {
+			collector.result(corners);
+			return;
+		}
+
+		windowWeights(window, type, weights);
+		ixx.resize(width + 2 * r);
+		iyy.resize(width + 2 * r);
+		ixy.resize(width + 2 * r);
+
+		// horizontal gefensterte Tensorzeilen, Zeile i liegt in Slot i % ringSize
+		int ringSize = window + 1;
+		ring.resize(ringSize * 3 * width);
+		sxx.resize(width);
+		syy.resize(width);
+		sxy.resize(width);
+		// Antwortzeilen y - 2 radius .. y
+		int responseRows = 2 * radius + 1;
+		response.resize(responseRows * width);
+		neighbours.resize(responseRows);
+
+		float kk = (float)k, omega = (float)threshold;
+		int next = 0;
+		for (int y = 0; y < height; ++y) {
+			// benötigte Tensorzeilen y-r .. y+r nachladen
+			for (; next <= std::min(y + r, height - 1); ++next) {
+				float *slot = &ring[(next % ringSize) * 3 * width];
+				windowedTensorRow(gray, next, weights, ixx, iyy, ixy, slot, slot + width, slot + 2 * width);
+			}
+
+			// vertikale Fensterung
+			std::fill(sxx.begin(), sxx.end(), 0.0f);
+			std::fill(syy.begin(), syy.end(), 0.0f);
+			std::fill(sxy.begin(), sxy.end(), 0.0f);
+			for (int i = -r; i <= r; ++i) {
+				const float *slot = &ring[(clampIndex(y + i, height) % ringSize) * 3 * width];
+				float w = weights[i + r];
+				for (int x = 0; x < width; ++x) {
+					sxx[x] += w * slot[x];
+					syy[x] += w * slot[width + x];
+					sxy[x] += w * slot[2 * width + x];
+				}
+			}
+			float *R = &response[(y % responseRows) * width];
+			for (int x = 0; x < width; ++x) {
+				float trace = sxx[x] + syy[x];
+				R[x] = sxx[x] * syy[x] - sxy[x] * sxy[x] - kk * trace * trace;
+			}
+
+			// Nicht-Maximum-Unterdrückung für Zeile y - radius
+			if (y >= 2 * radius) {
+				for (int i = 0; i < responseRows; ++i)
+					neighbours[i] = &response[((y - 2 * radius + i) % responseRows) * width];
+				suppressRow(&neighbours[radius], width, y - radius, radius, omega, collector);
+			}
+		}
+		collector.result(corners);
+	}
+
+private:
+	std::vector<float> weights;
+	/** Tensorprodukte einer Zeile mit Rand */
+	std::vector<float> ixx, iyy, ixy;
+	std::vector<float> ring;
+	std::vector<float> sxx, syy, sxy;
+	std::vector<float> response;
+	std::vector<const float *> neighbours;
+	PeakCollector collector;
+};
+
+/**
+ * Einzelnes Bild mit HarrisDetector::detect(); für Bildfolgen den Detektor
+ * behalten.
+ */
+inline std::vector<Peak> harrisCorners(const cv::Mat &gray, double k, double threshold,
+		int window = 3, HarrisWindow type = HARRIS_BOX, const PeakSelection &selection = PeakSelection()) {
+	HarrisDetector detector;
+	std::vector<Peak> corners;
+	detector.detect(gray, k, threshold, window, type, selection, corners);
+	return corners;
+}
+
+enum CornerMeasure { HARRIS_RESPONSE, SHI_TOMASI_RESPONSE };
+
+/**
+ * Integralbilder der Strukturtensor-Produkte Ixx, Iyy, Ixy (double, damit auch
+ * bei großen Bildern keine Auslöschung auftritt). Danach kostet jede
+ * Fenstergröße dieselben vier Zugriffe pro Pixel, so dass sich viele
+ * Fenstergrößen aus einer Vorberechnung auswerten lassen.
+ */
+class StructureTensorIntegral {
+public:
+	explicit StructureTensorIntegral(const cv::Mat &gray) : width(gray.cols), height(gray.rows) {
+		CV_Assert(gray.type() == CV_32FC1);
+		int stride = 3 * (width + 1);
+		sums.assign((size_t)stride * (height + 1), 0.0);
+		std::vector<float> xx(width), yy(width), xy(width);
+		for (int y = 0; y < height; ++y) {
+			harris_detail::tensorProductsRow(gray, y, &xx[0], &yy[0], &xy[0]);
+			const double *above = &sums[(size_t)y * stride];
+			double *row = &sums[(size_t)(y + 1) * stride];
+			double rxx = 0, ryy = 0, rxy = 0;
+			for (int x = 0; x < width; ++x) {
+				rxx += xx[x];
+				ryy += yy[x];
+				rxy += xy[x];
+				double *s = row + 3 * (x + 1);
+				const double *a = above + 3 * (x + 1);
+				s[0] = a[0] + rxx;
+				s[1] = a[1] + ryy;
+				s[2] = a[2] + rxy;
+			}
+		}
+	}
+
+	cv::Size size() const { return cv::Size(width, height); }
+
+	/**
+	 * Antwort für ein Box-Fenster der (ungeraden) Größe window nach CV_32FC1.
+	 * Harris: det A - k (trace A)^2, Shi-Tomasi: kleinerer Eigenwert von A.
+	 * A ist der Mittelwert über das Fenster; am Rand wird nur über den Teil
+	 * gemittelt, der im Bild liegt.
+	 */
+	void response(int window, CornerMeasure measure, double k, cv::Mat &R) const {
+		CV_Assert(window % 2 == 1 && window >= 1);
+		int r = window / 2, stride = 3 * (width + 1);
+		R.create(height, width, CV_32FC1);
+		for (int y = 0; y < height; ++y) {
+			int y0 = std::max(y - r, 0), y1 = std::min(y + r + 1, height);
+			const double *top = &sums[(size_t)y0 * stride], *bottom = &sums[(size_t)y1 * stride];
+			float *out = R.ptr<float>(y);
+			// innen liegt das Fenster vollständig im Bild
+			int inner0 = std::min(r, width), inner1 = std::max(width - r, inner0);
+			for (int x = 0; x < width; ++x) {
+				if (x == inner0 && inner0 < inner1) {
+					double norm = 1.0 / ((y1 - y0) * window);
+					for (; x < inner1; ++x)
+						out[x] = evaluate(top + 3 * (x - r), top + 3 * (x + r + 1),
+								bottom + 3 * (x - r), bottom + 3 * (x + r + 1), norm, measure, k);
+					if (x == width)
+						break;
+				}
+				int x0 = std::max(x - r, 0), x1 = std::min(x + r + 1, width);
+				out[x] = evaluate(top + 3 * x0, top + 3 * x1, bottom + 3 * x0, bottom + 3 * x1,
+						1.0 / ((y1 - y0) * (x1 - x0)), measure, k);
+			}
+		}
+	}
+
+	/**
+	 * Antworten für mehrere Fenstergrößen.
+	 */
+	void responses(const std::vector<int> &windows, CornerMeasure measure, double k, std::vector<cv::Mat> &R) const {
+		R.resize(windows.size());
+		for (size_t i = 0; i < windows.size(); ++i)
+			response(windows[i], measure, k, R[i]);
+	}
+
+private:
+	/**
+	 * Antwort aus den vier Ecken a (oben links) bis d (unten rechts) eines
+	 * Fensters, norm = 1 / Fläche.
+	 */
+	static float evaluate(const double *a, const double *b, const double *c, const double *d,
+			double norm, CornerMeasure measure, double k) {
+		double sxx = (d[0] - b[0] - c[0] + a[0]) * norm;
+		double syy = (d[1] - b[1] - c[1] + a[1]) * norm;
+		double sxy = (d[2] - b[2] - c[2] + a[2]) * norm;
+		double trace = sxx + syy;
+		if (measure == HARRIS_RESPONSE)
+			return (float)(sxx * syy - sxy * sxy - k * trace * trace);
+		double diff = 0.5 * (sxx - syy);
+		return (float)(0.5 * trace - std::sqrt(diff * diff + sxy * sxy));
+	}
+
+	int width, height;
+	// (height + 1) x (width + 1) Einträge zu je Ixx, Iyy, Ixy
+	std::vector<double> sums;
+};
+
+#endif
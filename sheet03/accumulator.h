@@ -0,0 +1,196 @@
+/**
+ * N-dimensionaler Hough-Akkumulator mit ganzzahligen Stimmen.
+ *
+ * Passt der Parameterraum (Produkt der Achsenlängen) unter maxDenseCells, wird
+ * er als ein zusammenhängendes Feld gehalten, sonst als Hashtabelle, die nur
+ * Zellen mit Stimmen speichert. Beide Formen werden über den linearen Index
+ * der Zelle angesprochen; die Maximumsuche arbeitet auf beiden gleich.
+ */
+
+#ifndef ACCUMULATOR_H
+#define ACCUMULATOR_H
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cv.h>
+
+template<int N>
+struct AccumulatorPeak {
+	cv::Vec<int, N> cell;
+	unsigned votes;
+};
+
+template<int N>
+class HoughAccumulator {
+public:
+	/** 2^25 Zellen, 128 MiB mit 32 Bit pro Zelle */
+	static const size_t DEFAULT_MAX_DENSE = (size_t)1 << 25;
+
+	explicit HoughAccumulator(const cv::Vec<int, N> &sizes, size_t maxDenseCells = DEFAULT_MAX_DENSE) : sizes(sizes) {
+		total = 1;
+		for (int i = N - 1; i >= 0; --i) {
+			CV_Assert(sizes[i] > 0);
+			strides[i] = total;
+			total *= (unsigned long long)sizes[i];
+		}
+		dense = total <= maxDenseCells;
+		if (dense)
+			denseCounts.assign((size_t)total, 0);
+	}
+
+	bool isDense() const { return dense; }
+
+	/** Anzahl der Zellen des Parameterraums */
+	unsigned long long cells() const { return total; }
+
+	/** Anzahl der gespeicherten Zellen (dicht: alle) */
+	size_t storedCells() const { return dense ? denseCounts.size() : sparseCounts.size(); }
+
+	void clear() {
+		if (dense)
+			std::fill(denseCounts.begin(), denseCounts.end(), 0u);
+		else
+			sparseCounts.clear();
+	}
+
+	/**
+	 * Stimme für cell; Zellen außerhalb des Parameterraums werden ignoriert.
+	 */
+	void vote(const cv::Vec<int, N> &cell, unsigned weight = 1) {
+		unsigned long long i;
+		if (!index(cell, i))
+			return;
+		if (dense)
+			denseCounts[(size_t)i] += weight;
+		else
+			sparseCounts[i] += weight;
+	}
+
+	unsigned count(const cv::Vec<int, N> &cell) const {
+		unsigned long long i;
+		return index(cell, i) ? count(i) : 0;
+	}
+
+	/**
+	 * Die maxPeaks stärksten Zellen mit mindestens minVotes Stimmen, die in
+	 * ihrer (2 radius + 1)^N-Umgebung maximal sind (bei Gleichstand gewinnt der
+	 * kleinere Index), absteigend nach Stimmen. maxPeaks = 0 liefert alle.
+	 * Mit maxPeaks > 0 werden die Kandidaten in einem Min-Heap fester Größe
+	 * gehalten (wie PeakCollector), der Speicher hängt dann nicht von der
+	 * Anzahl der lokalen Maxima ab.
+	 */
+	std::vector<AccumulatorPeak<N> > peaks(int maxPeaks, int radius, unsigned minVotes) const {
+		CV_Assert(radius >= 0 && minVotes > 0);
+		std::vector<Candidate> found;
+		if (maxPeaks > 0)
+			found.reserve(maxPeaks);
+		if (dense) {
+			for (size_t i = 0; i < denseCounts.size(); ++i) {
+				if (denseCounts[i] >= minVotes && localMaximum(i, denseCounts[i], radius))
+					offer(found, maxPeaks, Candidate(denseCounts[i], (unsigned long long)i));
+			}
+		} else {
+			for (typename Sparse::const_iterator it = sparseCounts.begin(); it != sparseCounts.end(); ++it) {
+				if (it->second >= minVotes && localMaximum(it->first, it->second, radius))
+					offer(found, maxPeaks, Candidate(it->second, it->first));
+			}
+		}
+
+		std::sort(found.begin(), found.end(), stronger);
+		std::vector<AccumulatorPeak<N> > result(found.size());
+		for (size_t k = 0; k < found.size(); ++k) {
+			result[k].cell = cellOf(found[k].second);
+			result[k].votes = found[k].first;
+		}
+		return result;
+	}
+
+private:
+	typedef std::unordered_map<unsigned long long, unsigned> Sparse;
+	/** Stimmen und linearer Index */
+	typedef std::pair<unsigned, unsigned long long> Candidate;
+
+	/** Absteigend nach Stimmen, dann aufsteigend nach Index */
+	static bool stronger(const Candidate &a, const Candidate &b) {
+		return a.first != b.first ? a.first > b.first : a.second < b.second;
+	}
+
+	/** Nimmt c auf; mit capacity > 0 als Min-Heap, dessen Wurzel der schwächste Kandidat ist */
+	static void offer(std::vector<Candidate> &heap, int capacity, const Candidate &c) {
+		if (capacity <= 0) {
+			heap.push_back(c);
+		} else if ((int)heap.size() < capacity) {
+			heap.push_back(c);
+			std::push_heap(heap.begin(), heap.end(), stronger);
+		} else if (stronger(c, heap.front())) {
+			std::pop_heap(heap.begin(), heap.end(), stronger);
+			heap.back() = c;
+			std::push_heap(heap.begin(), heap.end(), stronger);
+		}
+	}
+
+	bool index(const cv::Vec<int, N> &cell, unsigned long long &i) const {
+		i = 0;
+		for (int d = 0; d < N; ++d) {
+			if (cell[d] < 0 || cell[d] >= sizes[d])
+				return false;
+			i += cell[d] * strides[d];
+		}
+		return true;
+	}
+
+	cv::Vec<int, N> cellOf(unsigned long long i) const {
+		cv::Vec<int, N> cell;
+		for (int d = 0; d < N; ++d) {
+			cell[d] = (int)(i / strides[d]);
+			i %= strides[d];
+		}
+		return cell;
+	}
+
+	unsigned count(unsigned long long i) const {
+		if (dense)
+			return denseCounts[(size_t)i];
+		typename Sparse::const_iterator it = sparseCounts.find(i);
+		return it == sparseCounts.end() ? 0 : it->second;
+	}
+
+	/**
+	 * Größer als alle Nachbarn mit kleinerem Index, mindestens so groß wie die
+	 * mit größerem (wie bei der Kantenverdünnung), damit Plateaus genau ein
+	 * Maximum liefern.
+	 */
+	bool localMaximum(unsigned long long i, unsigned votes, int radius) const {
+		cv::Vec<int, N> center = cellOf(i);
+		int side = 2 * radius + 1, neighbours = 1;
+		for (int d = 0; d < N; ++d)
+			neighbours *= side;
+		for (int o = 0; o < neighbours; ++o) {
+			cv::Vec<int, N> cell;
+			long long offset = 0;
+			for (int d = N - 1, rest = o; d >= 0; --d, rest /= side) {
+				int delta = rest % side - radius;
+				cell[d] = center[d] + delta;
+				offset += delta * (long long)strides[d];
+			}
+			unsigned long long j;
+			if (offset == 0 || !index(cell, j))
+				continue;
+			unsigned other = count(j);
+			if (offset < 0 ? other >= votes : other > votes)
+				return false;
+		}
+		return true;
+	}
+
+	cv::Vec<int, N> sizes;
+	unsigned long long strides[N];
+	unsigned long long total;
+	bool dense;
+	std::vector<unsigned> denseCounts;
+	Sparse sparseCounts;
+};
+
+#endif
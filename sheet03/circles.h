@@ -0,0 +1,85 @@
+/**
+ * Hough-Transformation für Kreise (a, b, r) auf HoughAccumulator<3>.
+ *
+ * Der Mittelpunkt eines Kreises liegt vom Kantenpixel aus in Richtung des
+ * Gradienten oder entgegen (je nach Helligkeit innen und außen). Jedes Pixel
+ * stimmt daher nur für die zwei Mittelpunkte pro Radius ab, 2 (maxRadius -
+ * minRadius + 1) Stimmen statt eines ganzen Kegels im Parameterraum. Große
+ * Bilder mit großem Radienbereich werden automatisch dünn besetzt gezählt.
+ */
+
+#ifndef CIRCLES_H
+#define CIRCLES_H
+
+#include <cmath>
+#include <vector>
+#include <cv.h>
+
+#include "accumulator.h"
+
+struct HoughCircle {
+	cv::Point2f center;
+	float radius;
+	float votes;
+
+	HoughCircle() : radius(0), votes(0) {}
+	HoughCircle(cv::Point2f center, float radius, float votes) : center(center), radius(radius), votes(votes) {}
+};
+
+/**
+ * Radienbereich in Pixeln, höchstens maxCircles Kreise (0 = alle) mit
+ * mindestens minVotes Stimmen, Unterdrückungsradius in Zellen und Grenze für
+ * den dicht gespeicherten Parameterraum.
+ */
+struct CircleOptions {
+	int minRadius, maxRadius;
+	int maxCircles;
+	unsigned minVotes;
+	int suppression;
+	size_t maxDenseCells;
+
+	CircleOptions(int minRadius, int maxRadius, int maxCircles = 0, unsigned minVotes = 20, int suppression = 2,
+			size_t maxDenseCells = HoughAccumulator<3>::DEFAULT_MAX_DENSE)
+		: minRadius(minRadius), maxRadius(maxRadius), maxCircles(maxCircles), minVotes(minVotes),
+		  suppression(suppression), maxDenseCells(maxDenseCells) {}
+};
+
+/**
+ * Kreise auf den Kantenpixeln edges (CV_8UC1) mit den Sobel-Ableitungen gx,
+ * gy (CV_16SC1), absteigend nach Stimmen. Mittelpunkte außerhalb des Bildes
+ * werden nicht gezählt.
+ */
+inline std::vector<HoughCircle> houghCircles(const cv::Mat &edges, const cv::Mat &gx, const cv::Mat &gy,
+		const CircleOptions &options) {
+	CV_Assert(edges.type() == CV_8UC1 && gx.type() == CV_16SC1 && gy.type() == CV_16SC1);
+	CV_Assert(gx.size() == edges.size() && gy.size() == edges.size());
+	CV_Assert(options.minRadius >= 1 && options.maxRadius >= options.minRadius);
+	int radii = options.maxRadius - options.minRadius + 1;
+	HoughAccumulator<3> space(cv::Vec<int, 3>(edges.cols, edges.rows, radii), options.maxDenseCells);
+
+	for (int y = 0; y < edges.rows; ++y) {
+		const uchar *e = edges.ptr<uchar>(y);
+		const short *dx = gx.ptr<short>(y), *dy = gy.ptr<short>(y);
+		for (int x = 0; x < edges.cols; ++x) {
+			if (!e[x] || (dx[x] == 0 && dy[x] == 0))
+				continue;
+			double length = std::sqrt((double)dx[x] * dx[x] + (double)dy[x] * dy[x]);
+			double ux = dx[x] / length, uy = dy[x] / length;
+			for (int k = 0; k < radii; ++k) {
+				double r = options.minRadius + k;
+				space.vote(cv::Vec<int, 3>(cvRound(x + r * ux), cvRound(y + r * uy), k));
+				space.vote(cv::Vec<int, 3>(cvRound(x - r * ux), cvRound(y - r * uy), k));
+			}
+		}
+	}
+
+	std::vector<AccumulatorPeak<3> > peaks = space.peaks(options.maxCircles, options.suppression, options.minVotes);
+	std::vector<HoughCircle> circles(peaks.size());
+	for (size_t i = 0; i < peaks.size(); ++i) {
+		const cv::Vec<int, 3> &c = peaks[i].cell;
+		circles[i] = HoughCircle(cv::Point2f((float)c[0], (float)c[1]), (float)(options.minRadius + c[2]), (float)peaks[i].votes);
+	}
+	return circles;
+}
+
+#endif
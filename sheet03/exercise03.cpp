@@ -9,12 +9,18 @@
  */
 
 #include <iostream>
+#include <string>
 #include <vector>
 #include <algorithm>
 #include <queue>
 #include <cv.h>
 #include <highgui.h>
 
+#include "median.h"
+#include "hough.h"
+#include "circles.h"
+#include "../common/canny.h"
+
 /**
  * Aufgabe: Median-Filter (10 Punkte)
  *
@@ -24,69 +30,330 @@
  */
 
 /* TODO */
-cv::Mat medianBlur(const cv::Mat &src, int k = 3, int channel = 0) {
-	assert(src.channels() > channel);
-	//float or int? we do not know the underlying conversion, so just demand float for now
-	assert(src.depth() == CV_32F);
-	
-    cv::Mat dst = src.clone();
-	std::vector<float> values;
-	int dx = k/2;
-	int dy = k/2;
-
-	for(int y = dy; y < src.rows-dy; ++y) {
-		for(int x = dx; x < src.cols-dx; ++x) {
-			values.clear();
-
-			for(int wy = -dy; wy <= dy; ++wy) {
-				for(int wx = -dx; wx <= dx; ++wx) {
-					values.push_back(*(&(src.at<float>(y+wy,x+wx))+channel));
+// Sortiernetzwerke für k = 3, 5, sonst Histogramme mit konstantem Aufwand pro Pixel (median.h)
+cv::Mat medianBlur(const cv::Mat &src, int k = 3) {
+	cv::Mat dst;
+	medianFilter(src, dst, k);
+	return dst;
+}
+
+// Abstimmung nur um die Gradientenrichtung (gx, gy: Sobel, CV_16S)
+cv::Mat houghTransform(const cv::Mat &src, const cv::Mat &gx, const cv::Mat &gy, int thetaRes=256, int distRes=1024) {
+	HoughLines hough(src.size(), thetaRes, distRes);
+	hough.vote(src, gx, gy);
+	return hough.accumulator();
+}
+
+/**
+ * Skalierung der parallelen Hough-Abstimmung (alle Winkel und nach
+ * Gradientenrichtung) mit 1, 2, 4, ... maxThreads Threads auf den
+ * Canny-Kanten eines auf 4K vergrößerten Bildes; das Ergebnis wird mit dem
+ * einzelnen Thread verglichen.
+ * Aufruf: main --scaling <image> [max-threads]
+ */
+int scaling(int argc, char **argv) {
+	cv::Mat image = cv::imread(argv[2], CV_LOAD_IMAGE_GRAYSCALE);
+	if (!image.data) {
+		std::cerr << "could not load " << argv[2] << std::endl;
+		return -1;
+	}
+	int maxThreads = argc > 3 ? atoi(argv[3]) : 32;
+
+	cv::Mat gray, edges;
+	cv::resize(image, gray, cv::Size(3840, 2160));
+	EdgeDetector detector;
+	detector.detect(gray, edges);
+	std::cout << cv::countNonZero(edges) << " edge pixels" << std::endl;
+
+	const int runs = 3;
+	double ms = 1000.0 / cv::getTickFrequency(), single[2] = { 0, 0 };
+	cv::Mat reference[2];
+	for (int threads = 1; threads <= maxThreads; threads *= 2) {
+		RowBandExecutor executor(threads, 16);
+		for (int mode = 0; mode < 2; ++mode) {
+			HoughLines hough(edges.size());
+			int64 t0 = cv::getTickCount();
+			for (int i = 0; i < runs; ++i) {
+				hough.clear();
+				if (mode == 0)
+					hough.vote(edges, executor);
+				else
+					hough.vote(edges, detector.gradientX(), detector.gradientY(), executor);
+			}
+			double t = (cv::getTickCount() - t0) * ms / runs;
+			if (threads == 1) {
+				single[mode] = t;
+				reference[mode] = hough.votes().clone();
+			}
+			bool same = cv::countNonZero(hough.votes() != reference[mode]) == 0;
+			std::cout << threads << " threads, " << (mode == 0 ? "all angles: " : "gradient: ") << t
+				  << " ms, speedup " << single[mode] / t << (same ? "" : " (MISMATCH)") << std::endl;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Trefferquote und Laufzeit der progressiven Hough-Transformation bei
+ * verschiedenen Zeitbudgets, verglichen mit voller Abstimmung und
+ * Maximumsuche. Eine Gerade gilt als gefunden, wenn theta und rho höchstens
+ * zwei Zellen abweichen.
+ * Aufruf: main --progressive <image> [lines] [threshold]
+ */
+int progressiveRecall(int argc, char **argv) {
+	cv::Mat gray = cv::imread(argv[2], CV_LOAD_IMAGE_GRAYSCALE);
+	if (!gray.data) {
+		std::cerr << "could not load " << argv[2] << std::endl;
+		return -1;
+	}
+	int lines = argc > 3 ? atoi(argv[3]) : 20;
+	unsigned threshold = argc > 4 ? atoi(argv[4]) : 50;
+
+	cv::Mat edges;
+	EdgeDetector detector;
+	detector.detect(gray, edges);
+
+	double ms = 1000.0 / cv::getTickFrequency();
+	HoughLines exhaustive(edges.size());
+	int64 t0 = cv::getTickCount();
+	exhaustive.vote(edges);
+	std::vector<HoughLine> reference = exhaustive.peaks(lines);
+	std::cout << "exhaustive: " << (cv::getTickCount() - t0) * ms << " ms, " << reference.size() << " lines" << std::endl;
+
+	double thetaTolerance = 2 * CV_PI / exhaustive.thetaBins();
+	double rhoTolerance = 2 * exhaustive.distStep();
+	const double budgets[] = { 0.5, 1, 2, 5, 10, 20, 50, 0 };
+	for (int b = 0; b < 8; ++b) {
+		HoughLines hough(edges.size());
+		int64 t1 = cv::getTickCount();
+		std::vector<HoughLine> found = hough.progressive(edges, ProgressiveOptions(threshold, lines, budgets[b]));
+		double t = (cv::getTickCount() - t1) * ms;
+
+		int hits = 0;
+		for (size_t i = 0; i < reference.size(); ++i) {
+			for (size_t j = 0; j < found.size(); ++j) {
+				if (sameLine(reference[i], found[j], thetaTolerance, rhoTolerance)) {
+					++hits;
+					break;
 				}
 			}
-			std::sort(values.begin(), values.end());
-			*(&(dst.at<float>(y,x))+channel) = values[values.size() / 2];
 		}
+		std::cout << "budget " << (budgets[b] > 0 ? budgets[b] : INFINITY) << " ms: " << t << " ms, "
+			  << found.size() << " lines, recall " << (reference.empty() ? 1.0 : (double)hits / reference.size()) << std::endl;
+	}
+	return 0;
+}
+
+/**
+ * Hierarchische Hough-Transformation auf den Canny-Kanten eines auf 8K
+ * vergrößerten Bildes mit 0.02 Grad und 0.25 Pixel Zellgröße.
+ * Aufruf: main --hierarchical <image> [lines]
+ */
+int hierarchical(int argc, char **argv) {
+	cv::Mat image = cv::imread(argv[2], CV_LOAD_IMAGE_GRAYSCALE);
+	if (!image.data) {
+		std::cerr << "could not load " << argv[2] << std::endl;
+		return -1;
+	}
+	int lines = argc > 3 ? atoi(argv[3]) : 20;
+
+	cv::Mat gray, edges;
+	cv::resize(image, gray, cv::Size(7680, 4320));
+	EdgeDetector detector;
+	detector.detect(gray, edges);
+
+	HierarchicalOptions options(lines);
+	double ms = 1000.0 / cv::getTickFrequency();
+	int64 t0 = cv::getTickCount();
+	std::vector<HoughLine> found = hierarchicalLines(edges, options);
+	std::cout << found.size() << " lines in " << (cv::getTickCount() - t0) * ms << " ms" << std::endl;
+
+	double diagonal = std::sqrt(7680.0 * 7680.0 + 4320.0 * 4320.0);
+	size_t hierarchicalBytes = ((size_t)options.coarseTheta * options.coarseDist + options.localBins * options.localBins) * sizeof(int);
+	size_t flatBytes = (size_t)(2 * CV_PI / options.angleStep) * (size_t)(diagonal / options.distStep) * sizeof(int);
+	std::cout << "accumulators: " << hierarchicalBytes / 1024 << " KiB, flat at the same precision: "
+		  << flatBytes / (1024 * 1024) << " MiB" << std::endl;
+	for (size_t i = 0; i < found.size(); ++i)
+		std::cout << "theta " << found[i].theta * 180 / CV_PI << " deg, rho " << found[i].rho
+			  << ", votes " << found[i].votes << std::endl;
+	return 0;
+}
+
+/**
+ * Kreise über die Gradientenrichtung der Canny-Kanten finden und einzeichnen.
+ * Aufruf: main --circles <image> <min-radius> <max-radius> [circles]
+ */
+int circles(int argc, char **argv) {
+	cv::Mat image = cv::imread(argv[2], CV_LOAD_IMAGE_COLOR);
+	if (!image.data) {
+		std::cerr << "could not load " << argv[2] << std::endl;
+		return -1;
+	}
+	CircleOptions options(atoi(argv[3]), atoi(argv[4]), argc > 5 ? atoi(argv[5]) : 10);
+
+	cv::Mat gray, edges;
+	cv::cvtColor(image, gray, CV_BGR2GRAY);
+	cv::GaussianBlur(gray, gray, cv::Size(5, 5), 1.5);
+	EdgeDetector detector;
+	detector.detect(gray, edges);
+
+	double ms = 1000.0 / cv::getTickFrequency();
+	int64 t0 = cv::getTickCount();
+	std::vector<HoughCircle> found = houghCircles(edges, detector.gradientX(), detector.gradientY(), options);
+	std::cout << found.size() << " circles in " << (cv::getTickCount() - t0) * ms << " ms" << std::endl;
+
+	for (size_t i = 0; i < found.size(); ++i) {
+		std::cout << "(" << found[i].center.x << "," << found[i].center.y << ") r " << found[i].radius
+			  << ", votes " << found[i].votes << std::endl;
+		cv::circle(image, found[i].center, cvRound(found[i].radius), cv::Scalar(0, 0, 255), 1, CV_AA);
 	}
-    return dst;
+	cv::namedWindow("Hough Circles");
+	cv::imshow("Hough Circles", image);
+	cv::waitKey(0);
+	return 0;
 }
 
-cv::Mat houghTransform(const cv::Mat &src, int thetaRes=512, int distRes=512) {
-    cv::Mat accumBuffer(thetaRes, distRes, CV_32F);
-    accumBuffer.setTo(0);
-
-    int xres = src.cols, yres = src.rows;
-    float maxDist = sqrt(pow(xres, 2) + pow(yres, 2));
-    float distScale = distRes / maxDist;
-
-    float maxValue = 0;
-    for (int y = 0; y < yres; ++y) {
-        for (int x = 0; x < xres; ++x) {
-            if (src.at<uchar>(y, x) == 255) {
-                for(int i = 0; i < thetaRes; ++i) {
-                    float theta = 2 * i * CV_PI / thetaRes;
-                    float dist = x * cos(theta) + y * sin(theta);
-                    dist *= distScale;
-                    if(dist > 0 && dist < maxDist) {
-                        int cx = i, cy = dist;
-                        accumBuffer.at<float>(cy, cx) += 1;
-                        maxValue = std::max(accumBuffer.at<float>(cy, cx), maxValue);
-                    }
-                }
-            }
-        }
-    }
-
-    //normalize accumBuffer
-    for (int y = 0; y < accumBuffer.rows; ++y) {
-        for (int x = 0; x < accumBuffer.cols; ++x) {
-            if(maxValue > 0)
-                accumBuffer.at<float>(y, x) /= maxValue;
-        }
-    }
-    return accumBuffer;
+/**
+ * Zwei gleich lange waagrechte Strecken in benachbarten Zeilen, deren rho in
+ * benachbarte Zellen fällt: beide Zellen haben gleich viele Stimmen, peaks()
+ * muss trotzdem genau diese Gerade liefern. Die Strecken liegen nebeneinander,
+ * sonst sammeln leicht gekippte Winkel die Stimmen beider Zeilen in einer
+ * Zelle. Liefert die Anzahl der Fehler.
+ */
+int tiedPeak() {
+	cv::Mat edges(300, 1000, CV_8UC1, cv::Scalar(0));
+	// grobe Abstandsauflösung (etwa 2 Pixel), damit zwei Zeilen nicht eine Zelle überspringen
+	HoughLines hough(edges.size(), 256, 512);
+	int vertical = hough.thetaBins() / 2, y = 50, length = 400;
+	double cell = 0, next = 0;
+	for (;; ++y) {
+		cell = (y - hough.distance(0)) / hough.distStep();
+		next = (y + 1 - hough.distance(0)) / hough.distStep();
+		// beide Zeilen sicher innerhalb ihrer Zelle, in benachbarten Zellen
+		if ((int)next == (int)cell + 1 && cell - (int)cell > 0.1 && next - (int)next < 0.9)
+			break;
+	}
+	edges.row(y).colRange(50, 50 + length).setTo(255);
+	edges.row(y + 1).colRange(950 - length, 950).setTo(255);
+	hough.vote(edges);
+
+	int failures = 0;
+	if (hough.count(vertical, (int)cell) != (unsigned)length || hough.count(vertical, (int)next) != (unsigned)length) {
+		std::cerr << "tied peak: votes " << hough.count(vertical, (int)cell) << " and " << hough.count(vertical, (int)next)
+			  << " instead of " << length << std::endl;
+		++failures;
+	}
+	std::vector<HoughLine> found = hough.peaks(1);
+	HoughLine reference((float)(y + 0.5), (float)(CV_PI / 2), (float)length);
+	if (found.size() != 1 || found[0].votes != length
+			|| !sameLine(reference, found[0], CV_PI / hough.thetaBins(), hough.distStep())) {
+		std::cerr << "tied peak: line at rho " << y + 0.5 << " missing" << std::endl;
+		++failures;
+	}
+	return failures;
+}
+
+/**
+ * Regressionstest der Hough-Transformation: Canny-Kanten (EdgeDetector) von
+ * lines.png, die 20 stärksten Geraden aus peaks() müssen mit der Referenz
+ * übereinstimmen (theta und rho höchstens eine Zelle, Stimmen höchstens 2 %
+ * Abweichung), und die parallele Abstimmung muss zellgenau die serielle
+ * ergeben. Dazu kommt tiedPeak(). Das Bild wird farbig gelesen und mit cvtColor umgewandelt, damit
+ * die Graustufen nicht von der Konvertierung in libpng abhängen.
+ * Rückgabe 0 bei Erfolg, sonst 1.
+ * Aufruf: main --regression [lines.png]
+ */
+int regression(int argc, char **argv) {
+	// theta in Grad, rho in Pixeln, Stimmen
+	static const float expected[][3] = {
+		{ 90.0466f, 139.58f, 604 },
+		{ 91.3711f, 161.97f, 592 },
+		{ 90.2159f, 170.20f, 577 },
+		{ 90.0342f, 176.52f, 573 },
+		{ 93.9918f, 454.78f, 566 },
+		{ 91.4147f, 196.05f, 563 },
+		{ 93.2578f, 465.57f, 555 },
+		{ 96.3942f, 424.62f, 554 },
+		{ 95.7347f, 432.61f, 553 },
+		{ 88.5268f, 193.92f, 552 },
+		{ 57.7154f, 494.03f, 545 },
+		{ 92.4375f, 153.49f, 545 },
+		{ 93.0804f, 146.94f, 544 },
+		{ 91.4255f, 220.44f, 542 },
+		{ 91.6064f, 473.68f, 540 },
+		{ 61.1652f, 480.77f, 539 },
+		{ 95.4632f, 218.28f, 539 },
+		{ 91.1761f, 265.30f, 538 },
+		{ 86.6584f, 209.74f, 537 },
+		{ 60.5599f, 458.56f, 536 }
+	};
+	const int count = sizeof(expected) / sizeof(expected[0]);
+
+	const char *path = argc > 2 ? argv[2] : "lines.png";
+	cv::Mat image = cv::imread(path, CV_LOAD_IMAGE_COLOR);
+	if (!image.data) {
+		std::cerr << "could not load " << path << std::endl;
+		return 1;
+	}
+	cv::Mat gray, edges;
+	cv::cvtColor(image, gray, CV_BGR2GRAY);
+	EdgeDetector detector;
+	detector.detect(gray, edges);
+
+	HoughLines serial(edges.size()), parallel(edges.size());
+	serial.vote(edges);
+	RowBandExecutor executor(4, 16);
+	parallel.vote(edges, executor);
+	int failures = tiedPeak();
+	if (cv::countNonZero(serial.votes() != parallel.votes()) != 0) {
+		std::cerr << "parallel votes differ from serial votes" << std::endl;
+		++failures;
+	}
+
+	std::vector<HoughLine> found = serial.peaks(count);
+	if ((int)found.size() != count) {
+		std::cerr << found.size() << " lines instead of " << count << std::endl;
+		++failures;
+	}
+	double thetaTolerance = CV_PI / serial.thetaBins(), rhoTolerance = serial.distStep();
+	std::vector<bool> used(found.size(), false);
+	for (int i = 0; i < count; ++i) {
+		HoughLine reference(expected[i][1], (float)(expected[i][0] * CV_PI / 180), expected[i][2]);
+		size_t j = 0;
+		while (j < found.size() && (used[j] || !sameLine(reference, found[j], thetaTolerance, rhoTolerance)
+				|| std::abs(found[j].votes - reference.votes) > 0.02f * reference.votes))
+			++j;
+		if (j == found.size()) {
+			std::cerr << "missing: theta " << expected[i][0] << " deg, rho " << expected[i][1]
+				  << ", votes " << expected[i][2] << std::endl;
+			++failures;
+			continue;
+		}
+		used[j] = true;
+	}
+	for (size_t j = 0; j < found.size(); ++j) {
+		if (!used[j])
+			std::cerr << "unexpected: theta " << found[j].theta * 180 / CV_PI << " deg, rho " << found[j].rho
+				  << ", votes " << found[j].votes << std::endl;
+	}
+	if (failures)
+		std::cout << "FAILED: " << failures << " errors" << std::endl;
+	else
+		std::cout << "OK: " << count << " lines, parallel votes match" << std::endl;
+	return failures ? 1 : 0;
 }
 
 int main(int argc, char **argv) {
+	if (argc >= 3 && std::string(argv[1]) == "--scaling")
+		return scaling(argc, argv);
+	if (argc >= 3 && std::string(argv[1]) == "--progressive")
+		return progressiveRecall(argc, argv);
+	if (argc >= 3 && std::string(argv[1]) == "--hierarchical")
+		return hierarchical(argc, argv);
+	if (argc >= 5 && std::string(argv[1]) == "--circles")
+		return circles(argc, argv);
+	if (argc >= 2 && std::string(argv[1]) == "--regression")
+		return regression(argc, argv);
 	if (argc < 2) {
 		std::cerr << "usage: " << argv[0] << " <image>" << std::endl;
 		exit(1);
@@ -127,35 +394,9 @@ int main(int argc, char **argv) {
 	 */
 
 /* TODO */
-	cv::Mat blue, green, red;
-	// "channels" is a vector of 3 Mat arrays:
-	std::vector<cv::Mat> channels_vector(3);
-	// split img:
-	cv::split(img02, channels_vector);
-	// get the channels (BGR)
-	blue = medianBlur(channels_vector[0], kernel_size);
-	green = medianBlur(channels_vector[1], kernel_size);
-	red = medianBlur(channels_vector[2], kernel_size);
-	
-	cv::namedWindow( "Median Red", cv::WINDOW_AUTOSIZE );
-	cv::moveWindow( "Median Red", 100, 100);
-	cv::imshow( "Median Red", red );                   
-	cv::waitKey(0);
-	cv::namedWindow( "Median Green", cv::WINDOW_AUTOSIZE );
-	cv::moveWindow( "Median Green", 100, 100);
-	cv::imshow( "Median Green", green );                  
-	cv::waitKey(0);
-	cv::namedWindow( "Median Blue", cv::WINDOW_AUTOSIZE );
-	cv::moveWindow( "Median Blue", 100, 100);
-	cv::imshow( "Median Blue", blue );                   
-	cv::waitKey(0);
-
-    std::vector<cv::Mat> channels;
-    channels.push_back(blue);
-    channels.push_back(green);
-    channels.push_back(red);
-    cv::Mat medianImg;
-    cv::merge(channels, medianImg);
+	// alle Kanäle in einem Durchlauf über das verschränkte Bild
+	cv::Mat medianImg;
+	medianFilter(img02, medianImg, kernel_size);
 
 	cv::namedWindow( "Median Combined", cv::WINDOW_AUTOSIZE );
 	cv::moveWindow( "Median Combined", 100, 100);
@@ -167,6 +408,16 @@ int main(int argc, char **argv) {
 	 * - Wie kann man ungewollte Farbverschiebungen vermeiden?
 	 */
 
+	// Statt jeden Kanal einzeln zu filtern, ganze Pixel des Fensters übernehmen:
+	// hier das Pixel mit dem Median der Helligkeit.
+	cv::Mat luminanceImg;
+	medianFilter(img02, luminanceImg, kernel_size, MEDIAN_LUMINANCE);
+
+	cv::namedWindow( "Median Luminance", cv::WINDOW_AUTOSIZE );
+	cv::moveWindow( "Median Luminance", 100, 100);
+	cv::imshow( "Median Luminance", luminanceImg);
+	cv::waitKey(0);
+
 	/**
 	 * Aufgabe: Hough-Transformation (10 Punkte)
 	 *
@@ -229,7 +480,9 @@ int main(int argc, char **argv) {
 	/**
 	 * - Transformiere das Gradientenbild in den Hough-Raum und zeige das Bild an.
 	 */
-    cv::Mat hough = houghTransform(/*canny*/grad);
+	HoughLines lineSpace(grad.size());
+	lineSpace.vote(/*canny*/grad);
+	cv::Mat hough = lineSpace.accumulator();
 	//IplImage *hough = cvCreateImage(cvSize(400, 400), IPL_DEPTH_32F, 1);
 
 /* TODO */
@@ -242,41 +495,30 @@ int main(int argc, char **argv) {
 	cv::moveWindow( "Hough Space", 100, 100);
 	cv::imshow( "Hough Space", hough);
 	cv::waitKey(0);
+
+	cv::Mat houghOriented = houghTransform(grad, grad_x, grad_y);
+	cv::namedWindow("Hough Space (Gradient)", cv::WINDOW_AUTOSIZE);
+	cv::moveWindow( "Hough Space (Gradient)", 100, 100);
+	cv::imshow( "Hough Space (Gradient)", houghOriented);
+	cv::waitKey(0);
 	/**
 	 * - Finde die markantesten Linien und zeichne diese in das Originalbild ein.
 	 */
 
 /* TODO */
-	std::vector<cv::Point> line_vector;
+	// ein Durchlauf mit Nicht-Maximum-Unterdrückung statt wiederholtem minMaxLoc
 	int criteria = 20;  //number of best matches
-
-	cv::Mat hough_tmp = hough.clone();
-	for (int i = 0; i < criteria; ++i) {
-		cv::Point maximum;
-		cv::minMaxLoc(hough_tmp, 0, 0, 0, &maximum); 
-		line_vector.push_back(maximum);
-		hough_tmp.at<float>(maximum) = 0.f;
-	}
+	std::vector<HoughLine> line_vector = lineSpace.peaks(criteria);
 
 	cv::Mat img_mat = cv::Mat(img).clone();
-	for(int i = 0; i < line_vector.size(); ++i) {
-		//[0,512] -> [0, 2*pi]
-		float theta = 2.f*line_vector[i].x*CV_PI/hough.cols;
-		//[0, 512] -> [0, img-diag]
-		float imgDiag = sqrt(img->width*img->width + img->height*img->height);
-		float r = (float)line_vector[i].y/hough.rows * imgDiag;
-
-
-		cv::Point pt1, pt2;
-		double a = cos(theta), b = sin(theta);
-		double x0 = a*r, y0 = b*r;
-		pt1.x = cvRound(x0 + 1000*(-b));
-		pt1.y = cvRound(y0 + 1000*(a));
-		pt2.x = cvRound(x0 - 1000*(-b));
-		pt2.y = cvRound(y0 - 1000*(a));
+	for(size_t i = 0; i < line_vector.size(); ++i) {
+		cv::Point2f pt1, pt2;
+		if (!lineSegment(line_vector[i], img_mat.size(), pt1, pt2))
+			continue;
 		cv::line( img_mat, pt1, pt2, cv::Scalar(0,0,255), 1, CV_AA);
 
-		std::cout << "(" << pt1.x << "," << pt1.y << ") -- (" << pt2.x << "," << pt2.y << ")" << std::endl; 
+		std::cout << "rho " << line_vector[i].rho << ", theta " << line_vector[i].theta
+			  << ": (" << pt1.x << "," << pt1.y << ") -- (" << pt2.x << "," << pt2.y << ")" << std::endl;
 	}
 
 	cv::namedWindow("Hough Lines");
@@ -0,0 +1,731 @@
+/**
+ * Hough-Transformation für Geraden x cos(theta) + y sin(theta) = rho mit
+ * theta in [0, pi) und vorzeichenbehaftetem rho in [-D, D) (D: Bilddiagonale).
+ * Jede Gerade hat genau eine Zelle, und jede Stimme eines Pixels trifft eine
+ * Zelle; eine Hälfte des Winkelbereichs mit nur negativen Abständen gibt es
+ * nicht. Die Winkelzeilen sind periodisch mit gespiegeltem rho: (theta + pi,
+ * rho) ist (theta, -rho).
+ *
+ * Die Winkel sind diskret, cos und sin werden daher einmal pro Winkel (bereits
+ * mit der Abstandsauflösung skaliert) tabelliert. Ein Kantenpixel berechnet
+ * seine Abstände für 4 Winkel gleichzeitig; Abstände außerhalb (nur durch
+ * Rundung möglich) werden statt über einen Sprung in eine zusätzliche
+ * Abfallzelle gezählt. Gezählt wird in unsigned int, normiert wird erst bei
+ * der Darstellung.
+ *
+ * Parallel arbeitet jeder Thread auf einem eigenen Teilakkumulator mit 16 Bit
+ * pro Zelle. Ein Pixel erhöht jede Zelle höchstens einmal, daher wird ein
+ * Teilakkumulator spätestens nach 65535 Pixeln in die 32-Bit-Summe übertragen;
+ * am Ende werden alle Teilakkumulatoren zeilenweise parallel aufaddiert.
+ *
+ * Mit Gradienten stimmt ein Pixel nur in einem kleinen Winkelfenster um die
+ * Richtung seines Sobel-Gradienten (modulo pi) ab, statt über alle Winkel.
+ */
+
+#ifndef HOUGH_H
+#define HOUGH_H
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <vector>
+#include <cv.h>
+
+#include "../common/nms.h"
+#include "../common/parallel.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace hough_detail {
+
+/**
+ * Lage des Scheitels der Parabel durch (-1, a), (0, b), (1, c), in
+ * [-0.5, 0.5].
+ */
+inline double parabolaPeak(double a, double b, double c) {
+	double curvature = a - 2 * b + c;
+	if (curvature >= 0)
+		return 0;
+	return std::min(std::max(0.5 * (a - c) / curvature, -0.5), 0.5);
+}
+
+/**
+ * theta nach [0, pi) bringen, rho wechselt dabei je halber Drehung das
+ * Vorzeichen.
+ */
+inline void normalizeLine(double &theta, double &rho) {
+	double turns = std::floor(theta / CV_PI);
+	theta -= turns * CV_PI;
+	if ((long long)turns % 2 != 0)
+		rho = -rho;
+	if (theta >= CV_PI) {
+		theta -= CV_PI;
+		rho = -rho;
+	}
+}
+
+}
+
+/**
+ * Gerade x cos(theta) + y sin(theta) = rho mit der Anzahl ihrer Stimmen.
+ */
+struct HoughLine {
+	float rho, theta;
+	float votes;
+
+	HoughLine() : rho(0), theta(0), votes(0) {}
+	HoughLine(float rho, float theta, float votes) : rho(rho), theta(theta), votes(votes) {}
+};
+
+/**
+ * Ob a und b höchstens dTheta und dRho voneinander abweichen; theta wird
+ * periodisch mit gespiegeltem rho verglichen.
+ */
+inline bool sameLine(const HoughLine &a, const HoughLine &b, double dTheta, double dRho) {
+	double dt = std::abs(a.theta - b.theta);
+	if (dt > CV_PI / 2)
+		return CV_PI - dt <= dTheta && std::abs(a.rho + b.rho) <= dRho;
+	return dt <= dTheta && std::abs(a.rho - b.rho) <= dRho;
+}
+
+/**
+ * Einstellungen der progressiven Hough-Transformation: Schwelle der Stimmen
+ * für eine Gerade, höchstens maxLines Geraden (0 = alle), Zeitbudget in
+ * Millisekunden (0 = unbegrenzt), erlaubte Lücke entlang der Geraden und
+ * Mindestlänge der Strecke in Pixeln.
+ */
+struct ProgressiveOptions {
+	unsigned threshold;
+	int maxLines;
+	double budget;
+	int maxGap, minLength;
+	unsigned seed;
+
+	explicit ProgressiveOptions(unsigned threshold = 50, int maxLines = 0, double budget = 0,
+			int maxGap = 3, int minLength = 0, unsigned seed = 1)
+		: threshold(threshold), maxLines(maxLines), budget(budget), maxGap(maxGap), minLength(minLength), seed(seed) {}
+};
+
+class HoughLines {
+public:
+	/**
+	 * Akkumulator für Bilder der Größe size mit thetaRes Winkeln über [0, pi)
+	 * und distRes Abständen über [-D, D). Die Vorgaben entsprechen der
+	 * Auflösung von 512 x 512 Zellen über [0, 2 pi) x [0, D).
+	 */
+	HoughLines(cv::Size size, int thetaRes = 256, int distRes = 1024)
+		: thetaRes(thetaRes), distRes(distRes), cosTable(thetaRes), sinTable(thetaRes), offsets(thetaRes) {
+		CV_Assert(thetaRes > 0 && distRes > 0 && distRes % 2 == 0);
+		maxDist = std::sqrt((double)size.width * size.width + (double)size.height * size.height);
+		double distScale = distRes / (2 * maxDist);
+		for (int i = 0; i < thetaRes; ++i) {
+			double theta = angle(i);
+			cosTable[i] = (float)(std::cos(theta) * distScale);
+			sinTable[i] = (float)(std::sin(theta) * distScale);
+			offsets[i] = i * distRes;
+		}
+		// letzte Zelle nimmt die ungültigen Stimmen auf
+		counts.assign((size_t)thetaRes * distRes + 1, 0);
+	}
+
+	~HoughLines() {
+		for (size_t i = 0; i < partials.size(); ++i)
+			delete partials[i];
+	}
+
+	void clear() {
+		std::fill(counts.begin(), counts.end(), 0u);
+	}
+
+	/**
+	 * Jedes Pixel != 0 von edges (CV_8UC1) stimmt für alle Winkel ab.
+	 */
+	void vote(const cv::Mat &edges) {
+		CV_Assert(edges.type() == CV_8UC1);
+		voteRows(edges, 0, edges.rows, &counts[0]);
+	}
+
+	/**
+	 * Wie vote(edges), aber nur für Winkel, die höchstens spread (Bogenmaß)
+	 * von der Richtung des Gradienten (gx, gy, CV_16SC1) abweichen. Das
+	 * Vorzeichen des Gradienten spielt keine Rolle, da theta nur bis pi reicht.
+	 */
+	void vote(const cv::Mat &edges, const cv::Mat &gx, const cv::Mat &gy, double spread = CV_PI / 36) {
+		checkGradient(edges, gx, gy);
+		voteRows(edges, gx, gy, windowBins(spread), 0, edges.rows, &counts[0]);
+	}
+
+	/**
+	 * Parallele Varianten; das Ergebnis ist dasselbe wie mit einem Thread.
+	 */
+	void vote(const cv::Mat &edges, RowBandExecutor &executor) {
+		CV_Assert(edges.type() == CV_8UC1);
+		voteParallel(edges, executor, [&](int y0, int y1, ushort *acc) {
+			voteRows(edges, y0, y1, acc);
+		});
+	}
+
+	void vote(const cv::Mat &edges, const cv::Mat &gx, const cv::Mat &gy, RowBandExecutor &executor,
+			double spread = CV_PI / 36) {
+		checkGradient(edges, gx, gy);
+		int window = windowBins(spread);
+		voteParallel(edges, executor, [&](int y0, int y1, ushort *acc) {
+			voteRows(edges, gx, gy, window, y0, y1, acc);
+		});
+	}
+
+	/**
+	 * Rohe Stimmen ohne Kopie: CV_32SC1 mit thetaRes Zeilen und distRes
+	 * Spalten (Winkel-Hauptordnung, anders als accumulator()).
+	 */
+	cv::Mat votes() const {
+		return cv::Mat(thetaRes, distRes, CV_32SC1, const_cast<unsigned *>(&counts[0]));
+	}
+
+	/**
+	 * Akkumulator als CV_32FC1 mit distRes Zeilen und thetaRes Spalten, auf
+	 * das Maximum normiert.
+	 */
+	cv::Mat accumulator() const {
+		cv::Mat result(distRes, thetaRes, CV_32FC1);
+		unsigned maxCount = *std::max_element(counts.begin(), counts.end() - 1);
+		float scale = maxCount > 0 ? 1.f / maxCount : 0.f;
+		for (int d = 0; d < distRes; ++d) {
+			float *r = result.ptr<float>(d);
+			for (int i = 0; i < thetaRes; ++i)
+				r[i] = counts[offsets[i] + d] * scale;
+		}
+		return result;
+	}
+
+	/**
+	 * Die maxLines stärksten Geraden mit mindestens minVotes Stimmen, die im
+	 * (2 radius + 1)^2-Fenster maximal sind, absteigend nach Stimmen.
+	 * maxLines = 0 liefert alle.
+	 */
+	std::vector<HoughLine> peaks(int maxLines, int radius = 2, unsigned minVotes = 1) const {
+		CV_Assert(radius >= 1 && 2 * radius + 1 <= thetaRes);
+		PeakCollector collector(cv::Size(distRes + 2 * radius, thetaRes), PeakSelection(radius, maxLines));
+		// float-Zeilen mit radius Nullen links und rechts, im Ring über die
+		// nicht umgebrochenen Winkelindizes -radius .. thetaRes - 1 + radius,
+		// jenseits von 0 und pi mit gespiegeltem rho
+		int slots = 2 * radius + 1, width = distRes + 2 * radius;
+		std::vector<float> ring((size_t)slots * width, 0.f);
+		std::vector<int> stored(slots, INT_MIN);
+		std::vector<const float *> rows(slots);
+		for (int i = 0; i < thetaRes; ++i) {
+			for (int j = 0; j < slots; ++j) {
+				int k = i - radius + j, slot = (k + radius) % slots;
+				float *row = &ring[(size_t)slot * width];
+				if (stored[slot] != k) {
+					const unsigned *c = &counts[offsets[(k % thetaRes + thetaRes) % thetaRes]];
+					if (k >= 0 && k < thetaRes) {
+						for (int d = 0; d < distRes; ++d)
+							row[radius + d] = (float)c[d];
+					} else {
+						for (int d = 0; d < distRes; ++d)
+							row[radius + d] = (float)c[distRes - 1 - d];
+					}
+					stored[slot] = k;
+				}
+				rows[j] = row;
+			}
+			suppressRow(&rows[radius], width, i, radius, minVotes - 0.5f, collector);
+		}
+
+		std::vector<Peak> found = collector.result();
+		std::vector<HoughLine> lines(found.size());
+		for (size_t n = 0; n < found.size(); ++n) {
+			int i = found[n].pt.y, d = found[n].pt.x - radius;
+			float c = (float)count(i, d);
+			float up = i > 0 ? (float)count(i - 1, d) : (float)count(thetaRes - 1, distRes - 1 - d);
+			float down = i + 1 < thetaRes ? (float)count(i + 1, d) : (float)count(0, distRes - 1 - d);
+			float left = d > 0 ? (float)count(i, d - 1) : 0.f, right = d + 1 < distRes ? (float)count(i, d + 1) : 0.f;
+			// Stimmen für Zelle d stammen aus [d, d + 1), daher Mitte d + 0.5
+			double theta = angle(i) + hough_detail::parabolaPeak(up, c, down) * CV_PI / thetaRes;
+			double rho = distance(d + 0.5 + hough_detail::parabolaPeak(left, c, right));
+			hough_detail::normalizeLine(theta, rho);
+			lines[n] = HoughLine((float)rho, (float)theta, c);
+		}
+		return lines;
+	}
+
+	/**
+	 * Progressive probabilistische Hough-Transformation (Matas, Galambos und
+	 * Kittler 2000). Die Kantenpixel stimmen in zufälliger Reihenfolge ab.
+	 * Erreicht die stärkste Zelle des Pixels die Schwelle, wird die Gerade ab
+	 * dem Pixel in beide Richtungen verfolgt. Ihre Pixel werden entfernt;
+	 * nur wenn die Strecke die Mindestlänge erreicht, werden auch ihre
+	 * Stimmen zurückgenommen (wie in cv::HoughLinesP). segments erhält, falls
+	 * angegeben, die Endpunkte (x1, y1, x2, y2). Der Akkumulator wird vorher
+	 * gelöscht und enthält danach die Stimmen der übrigen Pixel und der Pixel
+	 * zu kurzer Strecken.
+	 */
+	std::vector<HoughLine> progressive(const cv::Mat &edges, const ProgressiveOptions &options,
+			std::vector<cv::Vec4i> *segments = 0) {
+		CV_Assert(edges.type() == CV_8UC1 && options.threshold > 0);
+		int64 start = cv::getTickCount();
+		clear();
+		if (segments)
+			segments->clear();
+		int width = edges.cols, height = edges.rows;
+		// 0: kein oder entferntes Kantenpixel, 1: wartet, 2: hat abgestimmt
+		std::vector<uchar> state((size_t)width * height, 0);
+		std::vector<int> order;
+		for (int y = 0; y < height; ++y) {
+			const uchar *e = edges.ptr<uchar>(y);
+			for (int x = 0; x < width; ++x) {
+				if (e[x]) {
+					state[(size_t)y * width + x] = 1;
+					order.push_back(y * width + x);
+				}
+			}
+		}
+
+		std::mt19937 random(options.seed);
+		double ticks = options.budget * cv::getTickFrequency() / 1000;
+		int dump = (int)counts.size() - 1;
+		std::vector<HoughLine> lines;
+		for (size_t n = 0; n < order.size(); ++n) {
+			if (options.maxLines > 0 && (int)lines.size() >= options.maxLines)
+				break;
+			if (options.budget > 0 && (n & 63) == 0 && cv::getTickCount() - start >= ticks)
+				break;
+			// Fisher-Yates schrittweise, damit ein früher Abbruch nichts kostet
+			std::swap(order[n], order[std::uniform_int_distribution<size_t>(n, order.size() - 1)(random)]);
+			int p = order[n];
+			if (state[p] != 1)
+				continue;
+			state[p] = 2;
+			int x = p % width, y = p / width;
+			int best = dump;
+			unsigned bestCount = 0;
+			forCells(x, y, 0, thetaRes, [&](int cell) {
+				unsigned c = ++counts[cell];
+				if (c > bestCount && cell != dump) {
+					bestCount = c;
+					best = cell;
+				}
+			});
+			if (bestCount < options.threshold)
+				continue;
+
+			int i = best / distRes, d = best % distRes;
+			double dx = -std::sin(angle(i)), dy = std::cos(angle(i));
+			double step = 1 / std::max(std::abs(dx), std::abs(dy));
+			dx *= step;
+			dy *= step;
+			// Nebenachse: senkrecht zur Schrittrichtung um je ein Pixel
+			int ox = std::abs(dx) < std::abs(dy), oy = 1 - ox;
+			// Die Richtung der Zelle weicht um bis zu eine halbe Zelle ab; die
+			// Verfolgung folgt daher den Pixeln um ein Pixel zur Seite.
+			cv::Point ends[2] = { cv::Point(x, y), cv::Point(x, y) };
+			support.assign(1, cv::Point(x, y));
+			for (int dir = 0; dir < 2; ++dir) {
+				double sx = dir == 0 ? dx : -dx, sy = dir == 0 ? dy : -dy;
+				for (int k = 1, gap = 0, shift = 0; gap <= options.maxGap; ++k) {
+					int px = cvRound(x + k * sx) + shift * ox, py = cvRound(y + k * sy) + shift * oy;
+					if (px < 0 || py < 0 || px >= width || py >= height)
+						break;
+					int found = 2;
+					for (int c = 0; c < 3 && found == 2; ++c) {
+						int o = c == 0 ? 0 : (c == 1 ? -1 : 1);
+						int qx = px + o * ox, qy = py + o * oy;
+						if (qx >= 0 && qy >= 0 && qx < width && qy < height && state[(size_t)qy * width + qx])
+							found = o;
+					}
+					if (found == 2) {
+						++gap;
+						continue;
+					}
+					shift += found;
+					ends[dir] = cv::Point(px + found * ox, py + found * oy);
+					support.push_back(ends[dir]);
+					gap = 0;
+				}
+			}
+			cv::Vec4i segment(ends[1].x, ends[1].y, ends[0].x, ends[0].y);
+			bool longEnough = std::sqrt(std::pow(double(segment[2] - segment[0]), 2)
+				+ std::pow(double(segment[3] - segment[1]), 2)) >= options.minLength;
+			// Pixel der Geraden samt seitlichen Nachbarn entfernen, Stimmen nur
+			// bei einer angenommenen Strecke zurücknehmen
+			for (size_t k = 0; k < support.size(); ++k) {
+				for (int o = -1; o <= 1; ++o) {
+					int qx = support[k].x + o * ox, qy = support[k].y + o * oy;
+					if (qx < 0 || qy < 0 || qx >= width || qy >= height)
+						continue;
+					uchar &s = state[(size_t)qy * width + qx];
+					if (s == 2 && longEnough)
+						forCells(qx, qy, 0, thetaRes, [this](int cell) { --counts[cell]; });
+					s = 0;
+				}
+			}
+			if (!longEnough)
+				continue;
+			lines.push_back(HoughLine((float)distance(d + 0.5), (float)angle(i), (float)bestCount));
+			if (segments)
+				segments->push_back(segment);
+		}
+		return lines;
+	}
+
+	unsigned count(int thetaIndex, int distIndex) const { return counts[offsets[thetaIndex] + distIndex]; }
+
+	double angle(int thetaIndex) const { return CV_PI * thetaIndex / thetaRes; }
+	/** rho am Anfang der (auch gebrochenen) Zelle distIndex */
+	double distance(double distIndex) const { return distIndex * distStep() - maxDist; }
+	double distStep() const { return 2 * maxDist / distRes; }
+
+	int thetaBins() const { return thetaRes; }
+	int distBins() const { return distRes; }
+
+private:
+	/** Teilakkumulator eines Threads */
+	struct Partial {
+		std::vector<ushort> counts;
+		/** Pixel seit der letzten Übertragung */
+		int pixels;
+	};
+
+	HoughLines(const HoughLines &);
+	HoughLines &operator=(const HoughLines &);
+
+	static void checkGradient(const cv::Mat &edges, const cv::Mat &gx, const cv::Mat &gy) {
+		CV_Assert(edges.type() == CV_8UC1 && gx.type() == CV_16SC1 && gy.type() == CV_16SC1);
+		CV_Assert(gx.size() == edges.size() && gy.size() == edges.size());
+	}
+
+	int windowBins(double spread) const {
+		return std::min((int)std::ceil(spread * thetaRes / CV_PI), (thetaRes - 1) / 2);
+	}
+
+	template<typename C>
+	void voteRows(const cv::Mat &edges, int y0, int y1, C *acc) const {
+		for (int y = y0; y < y1; ++y) {
+			const uchar *e = edges.ptr<uchar>(y);
+			for (int x = 0; x < edges.cols; ++x) {
+				if (e[x])
+					voteRange(acc, x, y, 0, thetaRes);
+			}
+		}
+	}
+
+	template<typename C>
+	void voteRows(const cv::Mat &edges, const cv::Mat &gx, const cv::Mat &gy, int window, int y0, int y1, C *acc) const {
+		double binsPerRadian = thetaRes / CV_PI;
+		for (int y = y0; y < y1; ++y) {
+			const uchar *e = edges.ptr<uchar>(y);
+			const short *dx = gx.ptr<short>(y), *dy = gy.ptr<short>(y);
+			for (int x = 0; x < edges.cols; ++x) {
+				if (!e[x] || (dx[x] == 0 && dy[x] == 0))
+					continue;
+				int center = cvRound(std::atan2((double)dy[x], (double)dx[x]) * binsPerRadian);
+				voteWrapped(acc, x, y, center - window, center + window + 1);
+			}
+		}
+	}
+
+	/**
+	 * Bänder werden zeilenweise in einen freien Teilakkumulator gezählt. Jedes
+	 * Kantenpixel erhöht eine Zelle höchstens um eins; erst wenn die
+	 * Kantenpixel seit der letzten Übertragung einen Zähler überlaufen lassen
+	 * könnten, wird er in counts übertragen.
+	 */
+	template<typename Body>
+	void voteParallel(const cv::Mat &edges, RowBandExecutor &executor, const Body &body) {
+		CV_Assert(edges.cols <= 65535);
+		executor.run(edges.rows, [&](int y0, int y1) {
+			Partial *partial = takePartial();
+			for (int y = y0; y < y1; ++y) {
+				const uchar *e = edges.ptr<uchar>(y);
+				int pixels = 0;
+				for (int x = 0; x < edges.cols; ++x)
+					pixels += e[x] != 0;
+				if (pixels == 0)
+					continue;
+				if (partial->pixels + pixels > 65535) {
+					std::lock_guard<std::mutex> lock(mutex);
+					addPartial(*partial, 0, thetaRes);
+					partial->pixels = 0;
+				}
+				body(y, y + 1, &partial->counts[0]);
+				partial->pixels += pixels;
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			available.push_back(partial);
+		});
+
+		// Reduktion über Winkelzeilen, jede Zeile unabhängig
+		executor.run(thetaRes, [&](int i0, int i1) {
+			for (size_t p = 0; p < partials.size(); ++p) {
+				if (partials[p]->pixels > 0)
+					addPartial(*partials[p], i0, i1);
+			}
+		});
+		for (size_t p = 0; p < partials.size(); ++p)
+			partials[p]->pixels = 0;
+	}
+
+	Partial *takePartial() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!available.empty()) {
+			Partial *partial = available.back();
+			available.pop_back();
+			return partial;
+		}
+		Partial *partial = new Partial();
+		partial->counts.assign(counts.size(), 0);
+		partial->pixels = 0;
+		partials.push_back(partial);
+		return partial;
+	}
+
+	/**
+	 * counts += partial für die Winkelzeilen [i0, i1), der Teilakkumulator
+	 * wird dabei gelöscht.
+	 */
+	void addPartial(Partial &partial, int i0, int i1) {
+		unsigned *dst = &counts[(size_t)i0 * distRes];
+		ushort *src = &partial.counts[(size_t)i0 * distRes];
+		size_t n = (size_t)(i1 - i0) * distRes, i = 0;
+#if defined(__SSE2__)
+		__m128i zero = _mm_setzero_si128();
+		for (; i + 8 <= n; i += 8) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+			__m128i lo = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(dst + i)), _mm_unpacklo_epi16(v, zero));
+			__m128i hi = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(dst + i + 4)), _mm_unpackhi_epi16(v, zero));
+			_mm_storeu_si128((__m128i *)(dst + i), lo);
+			_mm_storeu_si128((__m128i *)(dst + i + 4), hi);
+			_mm_storeu_si128((__m128i *)(src + i), zero);
+		}
+#endif
+		for (; i < n; ++i) {
+			dst[i] += src[i];
+			src[i] = 0;
+		}
+	}
+
+	/**
+	 * Winkelbereich [begin, end) modulo thetaRes.
+	 */
+	template<typename C>
+	void voteWrapped(C *acc, int x, int y, int begin, int end) const {
+		int length = end - begin;
+		begin = (begin % thetaRes + thetaRes) % thetaRes;
+		end = begin + length;
+		if (end <= thetaRes) {
+			voteRange(acc, x, y, begin, end);
+		} else {
+			voteRange(acc, x, y, begin, thetaRes);
+			voteRange(acc, x, y, 0, end - thetaRes);
+		}
+	}
+
+	template<typename C>
+	void voteRange(C *acc, int x, int y, int begin, int end) const {
+		forCells(x, y, begin, end, [acc](int cell) { ++acc[cell]; });
+	}
+
+	/**
+	 * Ruft op(Zelle) für die Winkel [begin, end) des Pixels (x, y) auf;
+	 * Abstände außerhalb liefern die Abfallzelle.
+	 */
+	template<typename Op>
+	void forCells(int x, int y, int begin, int end, const Op &op) const {
+		int dump = (int)counts.size() - 1;
+		// rho = -D liegt bei Zelle 0
+		float half = distRes / 2.f;
+		int i = begin;
+#if defined(__SSE2__)
+		__m128 vx = _mm_set1_ps((float)x), vy = _mm_set1_ps((float)y), vhalf = _mm_set1_ps(half);
+		__m128i limit = _mm_set1_epi32(distRes), vdump = _mm_set1_epi32(dump);
+		int index[4];
+		for (; i + 4 <= end; i += 4) {
+			__m128 dist = _mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(&cosTable[i])), _mm_mul_ps(vy, _mm_loadu_ps(&sinTable[i])));
+			dist = _mm_add_ps(dist, vhalf);
+			// Abschneiden wie die skalare Umwandlung
+			__m128i d = _mm_cvttps_epi32(dist);
+			__m128i valid = _mm_and_si128(_mm_castps_si128(_mm_cmpge_ps(dist, _mm_setzero_ps())), _mm_cmplt_epi32(d, limit));
+			__m128i cell = _mm_add_epi32(_mm_loadu_si128((const __m128i *)&offsets[i]), d);
+			cell = _mm_or_si128(_mm_and_si128(valid, cell), _mm_andnot_si128(valid, vdump));
+			_mm_storeu_si128((__m128i *)index, cell);
+			op(index[0]);
+			op(index[1]);
+			op(index[2]);
+			op(index[3]);
+		}
+#endif
+		for (; i < end; ++i) {
+			float dist = x * cosTable[i] + y * sinTable[i] + half;
+			int d = (int)dist;
+			op(dist >= 0 && d < distRes ? offsets[i] + d : dump);
+		}
+	}
+
+	int thetaRes, distRes;
+	double maxDist;
+	std::vector<float> cosTable, sinTable;
+	/** Beginn der Zeile eines Winkels im Akkumulator (Winkel-Hauptordnung) */
+	std::vector<int> offsets;
+	std::vector<unsigned> counts;
+
+	std::mutex mutex;
+	std::vector<Partial *> partials, available;
+	/** Pixel der zuletzt verfolgten Geraden in progressive() */
+	std::vector<cv::Point> support;
+};
+
+/**
+ * Schnitt der Geraden mit dem Bild [0, width - 1] x [0, height - 1]
+ * (Liang-Barsky); false, wenn die Gerade das Bild verfehlt.
+ */
+inline bool lineSegment(const HoughLine &line, cv::Size size, cv::Point2f &p1, cv::Point2f &p2) {
+	double c = std::cos(line.theta), s = std::sin(line.theta);
+	// Fußpunkt rho (c, s), Richtung (-s, c)
+	double x0 = line.rho * c, y0 = line.rho * s, dx = -s, dy = c;
+	double t0 = -1e30, t1 = 1e30;
+	const double p[4] = { -dx, dx, -dy, dy };
+	const double q[4] = { x0, size.width - 1 - x0, y0, size.height - 1 - y0 };
+	for (int i = 0; i < 4; ++i) {
+		if (std::abs(p[i]) < 1e-12) {
+			if (q[i] < 0)
+				return false;
+		} else {
+			double t = q[i] / p[i];
+			if (p[i] < 0)
+				t0 = std::max(t0, t);
+			else
+				t1 = std::min(t1, t);
+		}
+	}
+	if (t0 > t1)
+		return false;
+	p1 = cv::Point2f((float)(x0 + t0 * dx), (float)(y0 + t0 * dy));
+	p2 = cv::Point2f((float)(x0 + t1 * dx), (float)(y0 + t1 * dy));
+	return true;
+}
+
+/**
+ * Einstellungen von hierarchicalLines(): Anzahl der Geraden, gewünschte
+ * Zellgröße in theta (Bogenmaß) und rho (Pixel), Auflösung der groben Stufe
+ * und Zellen pro Achse der lokalen Akkumulatoren.
+ */
+struct HierarchicalOptions {
+	int maxLines;
+	double angleStep, distStep;
+	int coarseTheta, coarseDist;
+	int localBins;
+
+	explicit HierarchicalOptions(int maxLines = 20, double angleStep = 0.02 * CV_PI / 180, double distStep = 0.25,
+			int coarseTheta = 256, int coarseDist = 1024, int localBins = 16)
+		: maxLines(maxLines), angleStep(angleStep), distStep(distStep),
+		  coarseTheta(coarseTheta), coarseDist(coarseDist), localBins(localBins) {}
+};
+
+/**
+ * Hough-Transformation von grob nach fein. Die Kandidaten stammen aus einem
+ * groben Akkumulator; um jeden wird ein Fenster von +-2 Zellen mit
+ * localBins^2 Zellen neu abgestimmt, dann das Fenster um das Maximum auf +-2
+ * der neuen Zellen verkleinert, bis die gewünschte Zellgröße erreicht ist.
+ * Abgestimmt wird jeweils nur mit den Kantenpixeln, die das Fenster erreichen
+ * können. Neben dem groben Akkumulator wird nur ein lokaler Akkumulator
+ * gebraucht, unabhängig von der Genauigkeit.
+ */
+inline std::vector<HoughLine> hierarchicalLines(const cv::Mat &edges, const HierarchicalOptions &options) {
+	CV_Assert(edges.type() == CV_8UC1 && options.localBins >= 4);
+	CV_Assert(options.angleStep > 0 && options.distStep > 0);
+	HoughLines coarse(edges.size(), options.coarseTheta, options.coarseDist);
+	coarse.vote(edges);
+	// Nebenmaxima langer Geraden liegen in der groben Stufe oft außerhalb der
+	// Unterdrückung; sie laufen bei der Verfeinerung auf die Gerade zu und
+	// werden am Ende entfernt, daher doppelt so viele Kandidaten.
+	std::vector<HoughLine> candidates = coarse.peaks(2 * options.maxLines);
+
+	std::vector<cv::Point2f> points, band, previous;
+	for (int y = 0; y < edges.rows; ++y) {
+		const uchar *e = edges.ptr<uchar>(y);
+		for (int x = 0; x < edges.cols; ++x) {
+			if (e[x])
+				points.push_back(cv::Point2f((float)x, (float)y));
+		}
+	}
+
+	int n = options.localBins;
+	double diagonal = std::sqrt((double)edges.cols * edges.cols + (double)edges.rows * edges.rows);
+	std::vector<int> acc((size_t)n * n);
+	std::vector<double> cosTable(n), sinTable(n);
+	std::vector<HoughLine> lines;
+	for (size_t c = 0; c < candidates.size(); ++c) {
+		double theta = candidates[c].theta, rho = candidates[c].rho;
+		double halfTheta = 2 * CV_PI / options.coarseTheta, halfRho = 2 * coarse.distStep();
+		float votes = candidates[c].votes;
+		previous = points;
+		for (;;) {
+			double stepTheta = 2 * halfTheta / n, stepRho = 2 * halfRho / n;
+			double theta0 = theta - halfTheta, rho0 = rho - halfRho;
+			// rho eines Pixels ändert sich im Fenster höchstens um
+			// |t| halfTheta + diagonal halfTheta^2 / 2 (t: Lage entlang der Geraden)
+			double ct = std::cos(theta), st = std::sin(theta);
+			band.clear();
+			for (size_t i = 0; i < previous.size(); ++i) {
+				const cv::Point2f &p = previous[i];
+				double along = std::abs(-p.x * st + p.y * ct);
+				double reach = halfRho + along * halfTheta + diagonal * halfTheta * halfTheta / 2 + stepRho;
+				if (std::abs(p.x * ct + p.y * st - rho) <= reach)
+					band.push_back(p);
+			}
+			previous.swap(band);
+
+			for (int j = 0; j < n; ++j) {
+				cosTable[j] = std::cos(theta0 + j * stepTheta);
+				sinTable[j] = std::sin(theta0 + j * stepTheta);
+			}
+			std::fill(acc.begin(), acc.end(), 0);
+			for (size_t i = 0; i < previous.size(); ++i) {
+				for (int j = 0; j < n; ++j) {
+					double k = (previous[i].x * cosTable[j] + previous[i].y * sinTable[j] - rho0) / stepRho;
+					if (k >= 0 && k < n)
+						++acc[j * n + (int)k];
+				}
+			}
+
+			int best = (int)(std::max_element(acc.begin(), acc.end()) - acc.begin());
+			int bj = best / n, bk = best % n;
+			double at = hough_detail::parabolaPeak(bj > 0 ? acc[best - n] : 0, acc[best], bj + 1 < n ? acc[best + n] : 0);
+			double ar = hough_detail::parabolaPeak(bk > 0 ? acc[best - 1] : 0, acc[best], bk + 1 < n ? acc[best + 1] : 0);
+			theta = theta0 + (bj + at) * stepTheta;
+			// Zelle k sammelt [k, k + 1), daher Mitte k + 0.5
+			rho = rho0 + (bk + 0.5 + ar) * stepRho;
+			votes = (float)acc[best];
+			bool thetaDone = stepTheta <= options.angleStep, rhoDone = stepRho <= options.distStep;
+			if (thetaDone && rhoDone)
+				break;
+			if (!thetaDone)
+				halfTheta = 2 * stepTheta;
+			if (!rhoDone)
+				halfRho = 2 * stepRho;
+		}
+		hough_detail::normalizeLine(theta, rho);
+		lines.push_back(HoughLine((float)rho, (float)theta, votes));
+	}
+
+	// Geraden, die innerhalb von 2 groben Zellen einer stärkeren liegen
+	std::sort(lines.begin(), lines.end(), [](const HoughLine &a, const HoughLine &b) { return a.votes > b.votes; });
+	std::vector<HoughLine> distinct;
+	for (size_t i = 0; i < lines.size(); ++i) {
+		if (options.maxLines > 0 && (int)distinct.size() >= options.maxLines)
+			break;
+		bool duplicate = false;
+		for (size_t j = 0; j < distinct.size() && !duplicate; ++j)
+			duplicate = sameLine(lines[i], distinct[j], 2 * CV_PI / options.coarseTheta, 2 * coarse.distStep());
+		if (!duplicate)
+			distinct.push_back(lines[i]);
+	}
+	return distinct;
+}
+
+#endif
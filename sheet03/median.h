@@ -0,0 +1,659 @@
+/**
+ * Median-Filter für 8-Bit-, 16-Bit- und float-Bilder mit 1 bis 4 Kanälen.
+ *
+ * Mehrkanalige Bilder werden direkt auf den verschränkten Daten gefiltert,
+ * ohne Aufteilen in Ebenen. k = 3 und k = 5 laufen über Sortiernetzwerke
+ * (9 bzw. 25 Elemente), die auf ganze SSE-Register angewendet werden. Größere
+ * Fenster verwenden Histogramme: 8 Bit nach Perreault und Hébert (Median
+ * Filtering in Constant Time, 2007) mit Spaltenhistogrammen, also konstantem
+ * Aufwand pro Pixel (bis k = 255, darüber wie 16 Bit); 16 Bit ebenso mit
+ * vierstufigen Spaltenhistogrammen in Streifen fester Breite; float-Bilder
+ * werden dafür auf 16 Bit quantisiert.
+ *
+ * Die Verfahren halten die noch benötigten Originalzeilen in einem
+ * Ringpuffer (16 Bit: bei Bedarf in einer Kopie), src und dst dürfen daher dasselbe
+ * Bild sein. Am Rand wird das Bild fortgesetzt (Randwiederholung).
+ */
+
+#ifndef MEDIAN_H
+#define MEDIAN_H
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <cv.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * MEDIAN_MARGINAL filtert jeden Kanal für sich. MEDIAN_LUMINANCE wählt das
+ * Pixel des Fensters, dessen Helligkeit der Median der Helligkeiten ist,
+ * MEDIAN_VECTOR das Pixel mit der kleinsten Summe der L1-Abstände zu allen
+ * anderen (Aufwand quadratisch in k^2). Beide übernehmen ganze Pixel und
+ * vermeiden so Farbverschiebungen.
+ */
+enum MedianMode { MEDIAN_MARGINAL, MEDIAN_LUMINANCE, MEDIAN_VECTOR };
+
+namespace median_detail {
+
+inline int clampIndex(int i, int n) {
+	return std::min(std::max(i, 0), n - 1);
+}
+
+/**
+ * Kopien der zuletzt gelesenen Zeilen von src, links und rechts um r Pixel
+ * fortgesetzt. get(y) muss für jede Zeile aufgerufen werden, bevor sie in dst
+ * überschrieben wird, und in nicht fallender Reihenfolge.
+ */
+template<typename T>
+class RowHistory {
+public:
+	RowHistory(const cv::Mat &src, int slots, int r)
+		: src(src), slots(slots), channels(src.channels()), pad(r * src.channels()),
+		  length(src.cols * src.channels() + 2 * r * src.channels()),
+		  buffer((size_t)slots * length), index(slots, -1) {}
+
+	const T *get(int y) {
+		int slot = y % slots;
+		T *row = &buffer[(size_t)slot * length];
+		if (index[slot] != y) {
+			const T *s = src.ptr<T>(y);
+			int elements = src.cols * channels;
+			std::copy(s, s + elements, row + pad);
+			for (int i = 0; i < pad; i += channels) {
+				std::copy(s, s + channels, row + i);
+				std::copy(s + elements - channels, s + elements, row + pad + elements + i);
+			}
+			index[slot] = y;
+		}
+		return row + pad;
+	}
+
+private:
+	cv::Mat src;
+	int slots, channels, pad, length;
+	std::vector<T> buffer;
+	std::vector<int> index;
+};
+
+template<typename T>
+inline void sort2(T &a, T &b) {
+	T lo = std::min(a, b);
+	b = std::max(a, b);
+	a = lo;
+}
+
+#if defined(__SSE2__)
+struct U8x16 { __m128i v; };
+struct U16x8 { __m128i v; };
+struct F32x4 { __m128 v; };
+
+inline void sort2(U8x16 &a, U8x16 &b) {
+	__m128i lo = _mm_min_epu8(a.v, b.v);
+	b.v = _mm_max_epu8(a.v, b.v);
+	a.v = lo;
+}
+
+inline void sort2(U16x8 &a, U16x8 &b) {
+	// min/max ohne SSE4.1 über die sättigende Subtraktion
+	__m128i d = _mm_subs_epu16(a.v, b.v);
+	a.v = _mm_sub_epi16(a.v, d);
+	b.v = _mm_add_epi16(b.v, d);
+}
+
+inline void sort2(F32x4 &a, F32x4 &b) {
+	__m128 lo = _mm_min_ps(a.v, b.v);
+	b.v = _mm_max_ps(a.v, b.v);
+	a.v = lo;
+}
+
+/**
+ * Laden und Speichern mehrerer benachbarter Werte als ein Register.
+ */
+template<typename T> struct SortNetVector;
+
+template<> struct SortNetVector<uchar> {
+	typedef U8x16 V;
+	enum { LANES = 16 };
+	static V load(const uchar *p) { V v = { _mm_loadu_si128((const __m128i *)p) }; return v; }
+	static void store(uchar *p, const V &v) { _mm_storeu_si128((__m128i *)p, v.v); }
+};
+
+template<> struct SortNetVector<ushort> {
+	typedef U16x8 V;
+	enum { LANES = 8 };
+	static V load(const ushort *p) { V v = { _mm_loadu_si128((const __m128i *)p) }; return v; }
+	static void store(ushort *p, const V &v) { _mm_storeu_si128((__m128i *)p, v.v); }
+};
+
+template<> struct SortNetVector<float> {
+	typedef F32x4 V;
+	enum { LANES = 4 };
+	static V load(const float *p) { V v = { _mm_loadu_ps(p) }; return v; }
+	static void store(float *p, const V &v) { _mm_storeu_ps(p, v.v); }
+};
+#endif
+
+/**
+ * Median von 9 Werten mit 19 Vergleichen (Paeth).
+ */
+template<typename V>
+inline V median9(V *p) {
+	sort2(p[1], p[2]); sort2(p[4], p[5]); sort2(p[7], p[8]);
+	sort2(p[0], p[1]); sort2(p[3], p[4]); sort2(p[6], p[7]);
+	sort2(p[1], p[2]); sort2(p[4], p[5]); sort2(p[7], p[8]);
+	sort2(p[0], p[3]); sort2(p[5], p[8]); sort2(p[4], p[7]);
+	sort2(p[3], p[6]); sort2(p[1], p[4]); sort2(p[2], p[5]);
+	sort2(p[4], p[7]); sort2(p[4], p[2]); sort2(p[6], p[4]);
+	sort2(p[4], p[2]);
+	return p[4];
+}
+
+/**
+ * Median von 25 Werten mit 99 Vergleichen (Devillard, Fast median search).
+ */
+template<typename V>
+inline V median25(V *p) {
+	sort2(p[0], p[1]);   sort2(p[3], p[4]);   sort2(p[2], p[4]);
+	sort2(p[2], p[3]);   sort2(p[6], p[7]);   sort2(p[5], p[7]);
+	sort2(p[5], p[6]);   sort2(p[9], p[10]);  sort2(p[8], p[10]);
+	sort2(p[8], p[9]);   sort2(p[12], p[13]); sort2(p[11], p[13]);
+	sort2(p[11], p[12]); sort2(p[15], p[16]); sort2(p[14], p[16]);
+	sort2(p[14], p[15]); sort2(p[18], p[19]); sort2(p[17], p[19]);
+	sort2(p[17], p[18]); sort2(p[21], p[22]); sort2(p[20], p[22]);
+	sort2(p[20], p[21]); sort2(p[23], p[24]); sort2(p[2], p[5]);
+	sort2(p[3], p[6]);   sort2(p[0], p[6]);   sort2(p[0], p[3]);
+	sort2(p[4], p[7]);   sort2(p[1], p[7]);   sort2(p[1], p[4]);
+	sort2(p[11], p[14]); sort2(p[8], p[14]);  sort2(p[8], p[11]);
+	sort2(p[12], p[15]); sort2(p[9], p[15]);  sort2(p[9], p[12]);
+	sort2(p[13], p[16]); sort2(p[10], p[16]); sort2(p[10], p[13]);
+	sort2(p[20], p[23]); sort2(p[17], p[23]); sort2(p[17], p[20]);
+	sort2(p[21], p[24]); sort2(p[18], p[24]); sort2(p[18], p[21]);
+	sort2(p[19], p[22]); sort2(p[8], p[17]);  sort2(p[9], p[18]);
+	sort2(p[0], p[18]);  sort2(p[0], p[9]);   sort2(p[10], p[19]);
+	sort2(p[1], p[19]);  sort2(p[1], p[10]);  sort2(p[11], p[20]);
+	sort2(p[2], p[20]);  sort2(p[2], p[11]);  sort2(p[12], p[21]);
+	sort2(p[3], p[21]);  sort2(p[3], p[12]);  sort2(p[13], p[22]);
+	sort2(p[4], p[22]);  sort2(p[4], p[13]);  sort2(p[14], p[23]);
+	sort2(p[5], p[23]);  sort2(p[5], p[14]);  sort2(p[15], p[24]);
+	sort2(p[6], p[24]);  sort2(p[6], p[15]);  sort2(p[7], p[16]);
+	sort2(p[7], p[19]);  sort2(p[13], p[21]); sort2(p[15], p[23]);
+	sort2(p[7], p[13]);  sort2(p[7], p[15]);  sort2(p[1], p[9]);
+	sort2(p[3], p[11]);  sort2(p[5], p[17]);  sort2(p[11], p[17]);
+	sort2(p[9], p[17]);  sort2(p[4], p[10]);  sort2(p[6], p[12]);
+	sort2(p[7], p[14]);  sort2(p[4], p[6]);   sort2(p[4], p[7]);
+	sort2(p[12], p[14]); sort2(p[10], p[14]); sort2(p[6], p[7]);
+	sort2(p[10], p[12]); sort2(p[6], p[10]);  sort2(p[6], p[17]);
+	sort2(p[12], p[17]); sort2(p[7], p[17]);  sort2(p[7], p[10]);
+	sort2(p[12], p[18]); sort2(p[7], p[12]);  sort2(p[10], p[18]);
+	sort2(p[12], p[20]); sort2(p[10], p[20]); sort2(p[10], p[12]);
+	return p[12];
+}
+
+/**
+ * Sortiernetzwerk für k = 3 oder 5. Die Nachbarn eines Wertes liegen cn
+ * Elemente auseinander, so dass ein Register 16/cn (8 Bit) Pixel mit allen
+ * Kanälen gleichzeitig filtert.
+ */
+template<typename T>
+inline void sortNetMedian(const cv::Mat &src, cv::Mat &dst, int k) {
+	int r = k / 2, cn = src.channels(), elements = src.cols * cn;
+	RowHistory<T> history(src, k, r);
+	dst.create(src.size(), src.type());
+	std::vector<const T *> rows(k);
+	for (int y = 0; y < src.rows; ++y) {
+		for (int i = 0; i < k; ++i)
+			rows[i] = history.get(clampIndex(y - r + i, src.rows)) - r * cn;
+		T *d = dst.ptr<T>(y);
+		int e = 0;
+#if defined(__SSE2__)
+		typedef SortNetVector<T> Vec;
+		typename Vec::V pv[25];
+		for (; e + Vec::LANES <= elements; e += Vec::LANES) {
+			for (int i = 0, n = 0; i < k; ++i)
+				for (int j = 0; j < k; ++j)
+					pv[n++] = Vec::load(rows[i] + e + j * cn);
+			Vec::store(d + e, k == 3 ? median9(pv) : median25(pv));
+		}
+#endif
+		T p[25];
+		for (; e < elements; ++e) {
+			for (int i = 0, n = 0; i < k; ++i)
+				for (int j = 0; j < k; ++j)
+					p[n++] = rows[i][e + j * cn];
+			d[e] = k == 3 ? median9(p) : median25(p);
+		}
+	}
+}
+
+/**
+ * acc += add - sub für 16 Zähler.
+ */
+inline void addSub16(ushort *acc, const ushort *add, const ushort *sub) {
+#if defined(__SSE2__)
+	for (int i = 0; i < 16; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(acc + i));
+		a = _mm_add_epi16(a, _mm_loadu_si128((const __m128i *)(add + i)));
+		a = _mm_sub_epi16(a, _mm_loadu_si128((const __m128i *)(sub + i)));
+		_mm_storeu_si128((__m128i *)(acc + i), a);
+	}
+#else
+	for (int i = 0; i < 16; ++i)
+		acc[i] += add[i] - sub[i];
+#endif
+}
+
+/**
+ * Perreault-Hébert für 8 Bit: pro Spalte ein grobes (16 Klassen) und ein
+ * feines (256 Klassen) Histogramm über k Zeilen. Das grobe
+ * Fensterhistogramm wird pro Pixel um eine Spalte verschoben, feine Klassen
+ * werden nur für die Klasse nachgeführt, in der der Median liegt.
+ *
+ * Die Kanäle laufen nacheinander je einmal über das ganze (verschränkte)
+ * Bild, so dass nur die Histogramme eines Kanals im Cache liegen müssen.
+ * Ein Durchlauf liest und schreibt nur seinen Kanal; der Ringpuffer wird pro
+ * Kanal neu gefüllt, src und dst dürfen daher weiterhin dasselbe Bild sein.
+ * Die 16-Bit-Zähler des Fensterhistogramms fassen k * k Werte nur bis
+ * k = 255.
+ */
+inline void histogramMedian8u(const cv::Mat &src, cv::Mat &dst, int k) {
+	CV_Assert(k <= 255);
+	int r = k / 2, cn = src.channels(), width = src.cols, height = src.rows;
+	// Spalte c gehört zum Bildpixel x = c - r
+	int columns = width + 2 * r;
+	int rank = k * k / 2;
+	std::vector<ushort> coarse((size_t)columns * 16), fine((size_t)columns * 256);
+	ushort kernelCoarse[16], kernelFine[256];
+	int valid[16];
+	dst.create(src.size(), src.type());
+	for (int ch = 0; ch < cn; ++ch) {
+		RowHistory<uchar> history(src, k + 1, r);
+		std::fill(coarse.begin(), coarse.end(), 0);
+		std::fill(fine.begin(), fine.end(), 0);
+		for (int i = -r; i <= r; ++i) {
+			const uchar *s = history.get(clampIndex(i, height)) - r * cn + ch;
+			for (int c = 0; c < columns; ++c) {
+				int v = s[c * cn];
+				++coarse[c * 16 + (v >> 4)];
+				++fine[c * 256 + v];
+			}
+		}
+
+		for (int y = 0; y < height; ++y) {
+			if (y > 0) {
+				int out = clampIndex(y - r - 1, height), in = clampIndex(y + r, height);
+				if (out != in) {
+					const uchar *so = history.get(out) - r * cn + ch, *si = history.get(in) - r * cn + ch;
+					for (int c = 0; c < columns; ++c) {
+						int vo = so[c * cn], vi = si[c * cn];
+						--coarse[c * 16 + (vo >> 4)];
+						--fine[c * 256 + vo];
+						++coarse[c * 16 + (vi >> 4)];
+						++fine[c * 256 + vi];
+					}
+				}
+			}
+
+			const ushort *cc = &coarse[0], *cf = &fine[0];
+			uchar *d = dst.ptr<uchar>(y) + ch;
+			std::memset(kernelCoarse, 0, sizeof(kernelCoarse));
+			for (int c = 0; c <= 2 * r; ++c)
+				for (int b = 0; b < 16; ++b)
+					kernelCoarse[b] += cc[c * 16 + b];
+			std::fill(valid, valid + 16, INT_MIN / 2);
+
+			for (int x = 0; x < width; ++x) {
+				if (x > 0)
+					addSub16(kernelCoarse, &cc[(x + 2 * r) * 16], &cc[(x - 1) * 16]);
+
+				int b = 0, count = 0;
+				while (count + kernelCoarse[b] <= rank)
+					count += kernelCoarse[b++];
+
+				// feine Klasse b auf die Fensterposition x bringen
+				ushort *f = &kernelFine[b * 16];
+				if (x - valid[b] > 2 * r) {
+					std::memset(f, 0, 16 * sizeof(ushort));
+					for (int c = x; c <= x + 2 * r; ++c)
+						for (int i = 0; i < 16; ++i)
+							f[i] += cf[c * 256 + b * 16 + i];
+				} else {
+					for (int s = valid[b] + 1; s <= x; ++s)
+						addSub16(f, &cf[(s + 2 * r) * 256 + b * 16], &cf[(s - 1) * 256 + b * 16]);
+				}
+				valid[b] = x;
+
+				int i = 0;
+				while (count + f[i] <= rank)
+					count += f[i++];
+				d[x * cn] = (uchar)(b * 16 + i);
+			}
+		}
+	}
+}
+
+/**
+ * acc += add - sub für 16 Zähler, Fensterzähler mit 32 Bit.
+ */
+inline void addSub16(int *acc, const ushort *add, const ushort *sub) {
+#if defined(__SSE2__)
+	__m128i zero = _mm_setzero_si128();
+	for (int i = 0; i < 16; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(add + i)), s = _mm_loadu_si128((const __m128i *)(sub + i));
+		__m128i lo = _mm_loadu_si128((const __m128i *)(acc + i)), hi = _mm_loadu_si128((const __m128i *)(acc + i + 4));
+		lo = _mm_sub_epi32(_mm_add_epi32(lo, _mm_unpacklo_epi16(a, zero)), _mm_unpacklo_epi16(s, zero));
+		hi = _mm_sub_epi32(_mm_add_epi32(hi, _mm_unpackhi_epi16(a, zero)), _mm_unpackhi_epi16(s, zero));
+		_mm_storeu_si128((__m128i *)(acc + i), lo);
+		_mm_storeu_si128((__m128i *)(acc + i + 4), hi);
+	}
+#else
+	for (int i = 0; i < 16; ++i)
+		acc[i] += add[i] - sub[i];
+#endif
+}
+
+/** Breite der Streifen, in denen histogramMedian16u arbeitet (mindestens k - 1) */
+const int MEDIAN16_STRIP = 64;
+
+/**
+ * Trägt v mit delta in die Spaltenhistogramme der Spalte c aller vier
+ * Stufen ein.
+ */
+inline void count16u(std::vector<ushort> *column, int c, int v, int delta) {
+	for (int l = 0; l < 4; ++l)
+		column[l][((size_t)c << (4 * l + 4)) + (v >> (12 - 4 * l))] += delta;
+}
+
+/**
+ * Perreault-Hébert für 16 Bit mit vier Stufen zu je 16 Klassen (Bits 15-12,
+ * 11-8, 7-4 und 3-0) statt grob/fein, damit jeder Schritt nur 16 Zähler
+ * verschiebt. Das Fensterhistogramm der obersten Stufe wird pro Pixel um
+ * eine Spalte verschoben, die darunter liegenden nur für die Klasse, in der
+ * der Median liegt. Wie bei 8 Bit ist der Aufwand pro Pixel damit
+ * unabhängig von k, solange der Median nicht bei fast jedem Pixel in eine
+ * andere feinste Klasse (16 Werte) springt, etwa in steilen Verläufen; dann
+ * wächst er wieder mit k.
+ *
+ * Die feinste Stufe braucht pro Spalte 65536 Zähler; das Bild wird daher
+ * kanalweise in Streifen von max(MEDIAN16_STRIP, k - 1) Pixeln Breite
+ * gefiltert, der Speicher wächst mit k, nicht mit der Bildbreite (k = 15:
+ * 78 Spalten, etwa 11 MB). Weil die Streifen die Originalzeilen ganz
+ * brauchen, wird src kopiert, wenn dst dasselbe Bild ist.
+ */
+inline void histogramMedian16u(const cv::Mat &src, cv::Mat &dst, int k) {
+	int r = k / 2, cn = src.channels(), width = src.cols, height = src.rows;
+	int rank = k * k / 2;
+	int strip = std::min(std::max(MEDIAN16_STRIP, 2 * r), width), columns = strip + 2 * r;
+	cv::Mat input = dst.data == src.data ? src.clone() : src;
+	dst.create(src.size(), src.type());
+
+	// Stufe l hat 16^(l + 1) Klassen pro Spalte; valid[l - 1] hält pro Klasse
+	// der Stufe l - 1 die Position, für die ihre 16 Unterklassen im Fenster stimmen
+	std::vector<ushort> column[4];
+	std::vector<int> window[4], valid[3];
+	for (int l = 0; l < 4; ++l) {
+		column[l].assign((size_t)columns << (4 * l + 4), 0);
+		window[l].assign((size_t)1 << (4 * l + 4), 0);
+		if (l < 3)
+			valid[l].resize((size_t)1 << (4 * l + 4));
+	}
+	std::vector<int> offset(columns);
+
+	for (int ch = 0; ch < cn; ++ch) {
+		for (int x0 = 0; x0 < width; x0 += strip) {
+			// Spalte c gehört zum Bildpixel x0 + c - r
+			int n = std::min(strip, width - x0), used = n + 2 * r;
+			for (int c = 0; c < used; ++c)
+				offset[c] = clampIndex(x0 + c - r, width) * cn + ch;
+			for (int i = -r; i <= r; ++i) {
+				const ushort *s = input.ptr<ushort>(clampIndex(i, height));
+				for (int c = 0; c < used; ++c)
+					count16u(column, c, s[offset[c]], 1);
+			}
+			for (int l = 0; l < 3; ++l)
+				std::fill(valid[l].begin(), valid[l].end(), INT_MIN / 2);
+
+			for (int y = 0; y < height; ++y) {
+				if (y > 0) {
+					int out = clampIndex(y - r - 1, height), in = clampIndex(y + r, height);
+					if (out != in) {
+						const ushort *so = input.ptr<ushort>(out), *si = input.ptr<ushort>(in);
+						for (int c = 0; c < used; ++c) {
+							count16u(column, c, so[offset[c]], -1);
+							count16u(column, c, si[offset[c]], 1);
+						}
+					}
+				}
+
+				// Positionen verschiedener Zeilen liegen mehr als 2r auseinander
+				int base = y * (strip + 2 * r + 1);
+				int *top = &window[0][0];
+				std::fill(top, top + 16, 0);
+				for (int c = 0; c <= 2 * r; ++c)
+					for (int b = 0; b < 16; ++b)
+						top[b] += column[0][c * 16 + b];
+				ushort *d = dst.ptr<ushort>(y) + x0 * cn + ch;
+
+				for (int x = 0; x < n; ++x) {
+					if (x > 0)
+						addSub16(top, &column[0][(x + 2 * r) * 16], &column[0][(x - 1) * 16]);
+
+					int b = 0, count = 0;
+					while (count + top[b] <= rank)
+						count += top[b++];
+					for (int l = 1; l < 4; ++l) {
+						// Unterklassen von b auf die Fensterposition x bringen
+						size_t stride = (size_t)16 << (4 * l);
+						const ushort *cf = &column[l][b * 16];
+						int *f = &window[l][b * 16];
+						int &last = valid[l - 1][b];
+						if (base + x - last > 2 * r) {
+							std::fill(f, f + 16, 0);
+							for (int c = x; c <= x + 2 * r; ++c)
+								for (int i = 0; i < 16; ++i)
+									f[i] += cf[c * stride + i];
+						} else {
+							for (int s = last - base + 1; s <= x; ++s)
+								addSub16(f, cf + (s + 2 * r) * stride, cf + (s - 1) * stride);
+						}
+						last = base + x;
+
+						int i = 0;
+						while (count + f[i] <= rank)
+							count += f[i++];
+						b = b * 16 + i;
+					}
+					d[x * cn] = (ushort)b;
+				}
+			}
+
+			// Fenster der letzten Zeile wieder entfernen, statt alle Spalten zu löschen
+			for (int i = height - 1 - r; i <= height - 1 + r; ++i) {
+				const ushort *s = input.ptr<ushort>(clampIndex(i, height));
+				for (int c = 0; c < used; ++c)
+					count16u(column, c, s[offset[c]], -1);
+			}
+		}
+	}
+}
+
+/**
+ * float über eine Quantisierung des Wertebereichs auf 16 Bit. Der Fehler ist
+ * höchstens eine halbe Quantisierungsstufe, (max - min) / 131070.
+ */
+inline void quantizedMedian32f(const cv::Mat &src, cv::Mat &dst, int k) {
+	float lo = src.ptr<float>(0)[0], hi = lo;
+	for (int y = 0; y < src.rows; ++y) {
+		const float *s = src.ptr<float>(y);
+		for (int x = 0; x < src.cols * src.channels(); ++x) {
+			lo = std::min(lo, s[x]);
+			hi = std::max(hi, s[x]);
+		}
+	}
+	double scale = hi > lo ? 65535.0 / (hi - lo) : 0;
+	cv::Mat quantized, filtered;
+	src.convertTo(quantized, CV_MAKETYPE(CV_16U, src.channels()), scale, -lo * scale);
+	histogramMedian16u(quantized, filtered, k);
+	filtered.convertTo(dst, src.type(), scale > 0 ? 1.0 / scale : 0, lo);
+}
+
+inline void marginalMedian(const cv::Mat &src, cv::Mat &dst, int k) {
+	int depth = src.depth();
+	if (k == 3 || k == 5) {
+		if (depth == CV_8U)
+			sortNetMedian<uchar>(src, dst, k);
+		else if (depth == CV_16U)
+			sortNetMedian<ushort>(src, dst, k);
+		else
+			sortNetMedian<float>(src, dst, k);
+	} else if (depth == CV_8U && k <= 255) {
+		histogramMedian8u(src, dst, k);
+	} else if (depth == CV_8U) {
+		cv::Mat wide, filtered;
+		src.convertTo(wide, CV_MAKETYPE(CV_16U, src.channels()));
+		histogramMedian16u(wide, filtered, k);
+		filtered.convertTo(dst, src.type());
+	} else if (depth == CV_16U) {
+		histogramMedian16u(src, dst, k);
+	} else {
+		quantizedMedian32f(src, dst, k);
+	}
+}
+
+/**
+ * Helligkeit eines BGR-Pixels (BT.601), für ganzzahlige Typen in 14 Bit
+ * Festkomma.
+ */
+template<typename T>
+inline T luminance(const T *p) {
+	return (T)((p[0] * 1868 + p[1] * 9617 + p[2] * 4899 + 8192) >> 14);
+}
+
+template<>
+inline float luminance<float>(const float *p) {
+	return 0.114f * p[0] + 0.587f * p[1] + 0.299f * p[2];
+}
+
+/**
+ * Ganze Pixel nach dem Median der Helligkeit: die Helligkeit wird mit den
+ * schnellen einkanaligen Verfahren gefiltert, dann wird im Fenster das Pixel
+ * mit der nächstliegenden Helligkeit übernommen (bei Gleichstand das
+ * mittlere).
+ */
+template<typename T>
+inline void luminanceMedian(const cv::Mat &src, cv::Mat &dst, int k) {
+	CV_Assert(src.channels() >= 3);
+	int r = k / 2, cn = src.channels(), width = src.cols, height = src.rows;
+	cv::Mat lum(src.size(), CV_MAKETYPE(src.depth(), 1)), lumMedian;
+	for (int y = 0; y < height; ++y) {
+		const T *s = src.ptr<T>(y);
+		T *l = lum.ptr<T>(y);
+		for (int x = 0; x < width; ++x)
+			l[x] = luminance(s + x * cn);
+	}
+	marginalMedian(lum, lumMedian, k);
+
+	RowHistory<T> history(src, k, r);
+	dst.create(src.size(), src.type());
+	std::vector<const T *> rows(k), lumRows(k);
+	for (int y = 0; y < height; ++y) {
+		for (int i = 0; i < k; ++i) {
+			int sy = clampIndex(y - r + i, height);
+			rows[i] = history.get(sy);
+			lumRows[i] = lum.ptr<T>(sy);
+		}
+		const T *target = lumMedian.ptr<T>(y);
+		T *d = dst.ptr<T>(y);
+		for (int x = 0; x < width; ++x) {
+			double best = std::fabs((double)lumRows[r][x] - target[x]);
+			const T *pixel = rows[r] + x * cn;
+			for (int i = 0; i < k && best > 0; ++i)
+				for (int j = -r; j <= r; ++j) {
+					int sx = clampIndex(x + j, width);
+					double diff = std::fabs((double)lumRows[i][sx] - target[x]);
+					if (diff < best) {
+						best = diff;
+						pixel = rows[i] + (x + j) * cn;
+					}
+				}
+			std::copy(pixel, pixel + cn, d + x * cn);
+		}
+	}
+}
+
+/**
+ * Vektormedian: das Pixel des Fensters mit der kleinsten Summe der
+ * L1-Abstände zu allen anderen (bei Gleichstand das mittlere).
+ */
+template<typename T>
+inline void vectorMedian(const cv::Mat &src, cv::Mat &dst, int k) {
+	int r = k / 2, cn = src.channels(), width = src.cols, height = src.rows, n = k * k;
+	RowHistory<T> history(src, k, r);
+	dst.create(src.size(), src.type());
+	std::vector<const T *> rows(k), pixels(n);
+	std::vector<double> distances(n);
+	for (int y = 0; y < height; ++y) {
+		for (int i = 0; i < k; ++i)
+			rows[i] = history.get(clampIndex(y - r + i, height));
+		T *d = dst.ptr<T>(y);
+		for (int x = 0; x < width; ++x) {
+			// Mitte zuerst, damit sie bei Gleichstand gewinnt
+			pixels[0] = rows[r] + x * cn;
+			for (int i = 0, m = 1; i < k; ++i)
+				for (int j = -r; j <= r; ++j)
+					if (i != r || j != 0)
+						pixels[m++] = rows[i] + (x + j) * cn;
+			std::fill(distances.begin(), distances.end(), 0.0);
+			for (int a = 0; a < n; ++a)
+				for (int b = a + 1; b < n; ++b) {
+					double dist = 0;
+					for (int ch = 0; ch < cn; ++ch)
+						dist += std::fabs((double)pixels[a][ch] - pixels[b][ch]);
+					distances[a] += dist;
+					distances[b] += dist;
+				}
+			int best = (int)(std::min_element(distances.begin(), distances.end()) - distances.begin());
+			std::copy(pixels[best], pixels[best] + cn, d + x * cn);
+		}
+	}
+}
+
+template<typename T>
+inline void pixelMedian(const cv::Mat &src, cv::Mat &dst, int k, MedianMode mode) {
+	if (mode == MEDIAN_LUMINANCE)
+		luminanceMedian<T>(src, dst, k);
+	else
+		vectorMedian<T>(src, dst, k);
+}
+
+}
+
+/**
+ * Median-Filter mit ungerader Fenstergröße k für 8U, 16U und 32F mit 1 bis 4
+ * Kanälen. dst darf gleich src sein. MEDIAN_LUMINANCE setzt mindestens drei
+ * Kanäle (BGR) voraus.
+ */
+inline void medianFilter(const cv::Mat &src, cv::Mat &dst, int k, MedianMode mode = MEDIAN_MARGINAL) {
+	using namespace median_detail;
+	int depth = src.depth();
+	CV_Assert(src.channels() <= 4 && k % 2 == 1 && k >= 1);
+	CV_Assert(depth == CV_8U || depth == CV_16U || depth == CV_32F);
+	if (k == 1) {
+		if (dst.data != src.data)
+			src.copyTo(dst);
+	} else if (mode == MEDIAN_MARGINAL || src.channels() == 1) {
+		marginalMedian(src, dst, k);
+	} else if (depth == CV_8U) {
+		pixelMedian<uchar>(src, dst, k, mode);
+	} else if (depth == CV_16U) {
+		pixelMedian<ushort>(src, dst, k, mode);
+	} else {
+		pixelMedian<float>(src, dst, k, mode);
+	}
+}
+
+#endif
@@ -13,15 +13,159 @@
 #include <vector>
 #include <math.h>
 #include <algorithm>
+#include <cstring>
+#include <sys/resource.h>
 #include <cv.h>
 #include <highgui.h>
 
-template<typename T> const T &min(const T &a, const T &b) { return a < b ? a : b; }
-template<typename T> const T &max(const T &a, const T &b) { return a > b ? a : b; }
+#include "../common/blend.h"
+
+// Punktkorrespondenzen zwischen left.png und right.png
+static const CvPoint points1[] = { cvPoint(463, 164), cvPoint(530, 357), cvPoint(618, 357), cvPoint(610, 153) };
+static const CvPoint points2[] = { cvPoint(225, 179), cvPoint(294, 370), cvPoint(379, 367), cvPoint(369, 168) };
+
+// Spitzenwert des belegten Hauptspeichers in MiB
+static double peakRssMiB() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0;
+}
+
+/**
+ * Lädt beide Bilder als CV_32FC1 und vergrößert sie samt Homographie so, dass
+ * das Panorama area etwa megapixels Millionen Pixel hat.
+ */
+static bool loadScaled(const char *file1, const char *file2, double megapixels, cv::Mat &left, cv::Mat &right,
+		cv::Mat &H, cv::Rect &area) {
+	cv::Mat img1 = cv::imread(file1, CV_LOAD_IMAGE_GRAYSCALE), img2 = cv::imread(file2, CV_LOAD_IMAGE_GRAYSCALE);
+	if (!img1.data || !img2.data) {
+		printf("Could not load image files: %s %s\n", file1, file2);
+		return false;
+	}
+
+	cv::Point2f pt1[4], pt2[4];
+	for (int i = 0; i < 4; ++i) {
+		pt1[i] = cv::Point2f(points1[i].x, points1[i].y);
+		pt2[i] = cv::Point2f(points2[i].x, points2[i].y);
+	}
+	H = cv::getPerspectiveTransform(pt1, pt2);
+	area = projectedBounds(H, img1.size()) | cv::Rect(cv::Point(0, 0), img2.size());
+
+	// Bilder und Homographie skalieren: H' = S H S^-1
+	double scale = sqrt(megapixels * 1e6 / area.area());
+	cv::Mat S = (cv::Mat_<double>(3, 3) << scale, 0, 0, 0, scale, 0, 0, 0, 1);
+	H = S * H * S.inv();
+	cv::resize(img1, left, cv::Size(), scale, scale);
+	cv::resize(img2, right, cv::Size(), scale, scale);
+	left.convertTo(left, CV_32F, 1.0 / 255.0);
+	right.convertTo(right, CV_32F, 1.0 / 255.0);
+	area = projectedBounds(H, left.size()) | cv::Rect(cv::Point(0, 0), right.size());
+	printf("inputs %dx%d, %dx%d, panorama %dx%d (%.1f MP)\n", left.cols, left.rows, right.cols, right.rows,
+			area.width, area.height, area.area() / 1e6);
+	return true;
+}
+
+/**
+ * Laufzeit und Spitzenspeicher des Panoramas aus beiden Bildern, die so
+ * vergrößert werden, dass die Leinwand etwa megapixels Millionen Pixel hat.
+ * Aufruf: main --bench <image-file-name1> <image-file-name2> [megapixels]
+ */
+int bench(int argc, char *argv[]) {
+	cv::Mat left, right, H;
+	cv::Rect area;
+	if (!loadScaled(argv[2], argv[3], argc > 4 ? atof(argv[4]) : 20, left, right, H, area))
+		return 1;
+	double before = peakRssMiB();
+
+	RowBandExecutor executor;
+	int64 t0 = cv::getTickCount();
+	PanoramaCanvas canvas(area, CV_32FC1, &executor);
+	canvas.add(left, H);
+	canvas.add(right, cv::Mat::eye(3, 3, CV_64F));
+	canvas.result();
+	double ms = (cv::getTickCount() - t0) * 1000.0 / cv::getTickFrequency();
+
+	printf("%.1f ms with %d threads, peak RSS %.1f MiB (%.1f MiB before assembly, canvas %.1f MiB)\n", ms,
+			executor.threads(), peakRssMiB(), before, area.area() * (sizeof(float) + 1) / (1024.0 * 1024.0));
+
+	// nur das linke Bild über die ganze Leinwand: überdeckte Spannen gegen cv::warpPerspective
+	cv::Mat T = (cv::Mat_<double>(3, 3) << 1, 0, -area.x, 0, 1, -area.y, 0, 0, 1), full;
+	t0 = cv::getTickCount();
+	cv::warpPerspective(left, full, T * H, area.size());
+	double msFull = (cv::getTickCount() - t0) * 1000.0 / cv::getTickFrequency();
+	std::vector<WarpSpan> spans;
+	t0 = cv::getTickCount();
+	size_t covered = PerspectiveWarp(H, left.size()).warp(left, area, full, spans, &executor);
+	double msSpans = (cv::getTickCount() - t0) * 1000.0 / cv::getTickFrequency();
+	printf("left image: cv::warpPerspective %.1f ms, PerspectiveWarp %.1f ms, %.1f%% of the canvas skipped\n",
+			msFull, msSpans, 100.0 * (1.0 - (double)covered / area.area()));
+	return 0;
+}
+
+/**
+ * Wie --bench, aber auf der gekachelten Leinwand mit höchstens resident
+ * Kacheln im Speicher; das Panorama wird streifenweise als PGM geschrieben.
+ * Aufruf: main --tiled <image-file-name1> <image-file-name2> <megapixels> <output.pgm> [resident-tiles]
+ */
+int tiled(int argc, char *argv[]) {
+	cv::Mat left, right, H;
+	cv::Rect area;
+	if (!loadScaled(argv[2], argv[3], atof(argv[4]), left, right, H, area))
+		return 1;
+	size_t resident = argc > 6 ? atoi(argv[6]) : 64;
+	double before = peakRssMiB();
+
+	RowBandExecutor executor;
+	int64 t0 = cv::getTickCount();
+	TiledCanvas canvas(area, CV_32FC1, TiledCanvas::DEFAULT_TILE_SIZE, resident, "", &executor);
+	canvas.add(left, H);
+	canvas.add(right, cv::Mat::eye(3, 3, CV_64F));
+	StripWriter writer(argv[5], area.size(), 1);
+	canvas.finish(writer);
+	double ms = (cv::getTickCount() - t0) * 1000.0 / cv::getTickFrequency();
+
+	const TiledCanvasStats &stats = canvas.stats();
+	printf("%.1f ms, peak RSS %.1f MiB (%.1f MiB before assembly)\n", ms, peakRssMiB(), before);
+	printf("%d of %d tiles created, at most %d resident, %d spilled, %d reloaded\n", (int)stats.tilesCreated,
+			canvas.gridSize().area(), (int)stats.peakResidentTiles, (int)stats.spills, (int)stats.reloads);
+	return 0;
+}
+
+/**
+ * Mehrband-Überblendung beider Bilder, auf etwa megapixels Millionen Pixel
+ * vergrößert, kachelweise als PGM geschrieben.
+ * Aufruf: main --multiband <image-file-name1> <image-file-name2> <megapixels> <output.pgm> [levels]
+ */
+int multiband(int argc, char *argv[]) {
+	cv::Mat left, right, H;
+	cv::Rect area;
+	if (!loadScaled(argv[2], argv[3], atof(argv[4]), left, right, H, area))
+		return 1;
+	int levels = argc > 6 ? atoi(argv[6]) : 5;
+	double before = peakRssMiB();
+
+	RowBandExecutor executor;
+	int64 t0 = cv::getTickCount();
+	MultiBandBlender blender(area, CV_32FC1, levels, 512, &executor);
+	blender.add(left, H);
+	blender.add(right, cv::Mat::eye(3, 3, CV_64F));
+	StripWriter writer(argv[5], area.size(), 1);
+	blender.finish(writer);
+	double ms = (cv::getTickCount() - t0) * 1000.0 / cv::getTickFrequency();
+
+	printf("%.1f ms, peak RSS %.1f MiB (%.1f MiB before blending, apron %d)\n", ms, peakRssMiB(), before, blender.apron());
+	return 0;
+}
 
 int main(int argc, char *argv[]) {
+	if (argc >= 4 && strcmp(argv[1], "--bench") == 0)
+		return bench(argc, argv);
+	if (argc >= 6 && strcmp(argv[1], "--tiled") == 0)
+		return tiled(argc, argv);
+	if (argc >= 6 && strcmp(argv[1], "--multiband") == 0)
+		return multiband(argc, argv);
 	if (argc < 3){
-		printf("Usage: %s <image-file-name1> <image-file-name2>\n", argv[0]);
+		printf("Usage: %s [--bench|--tiled|--multiband] <image-file-name1> <image-file-name2> [megapixels] [output.pgm] [resident-tiles|levels]\n", argv[0]);
 		exit(1);
 	}
 
@@ -38,7 +182,7 @@ int main(int argc, char *argv[]) {
 		printf("Could not load image file: %s\n", argv[2]);
 		exit(1);
 	}
-	IplImage* img2f = cvCreateImage(cvGetSize(img1), IPL_DEPTH_32F, 1);
+	IplImage* img2f = cvCreateImage(cvGetSize(img2), IPL_DEPTH_32F, 1);
 	cvConvertScale(img2, img2f, 1.0 / 255.0);
 
 	/**
@@ -101,8 +245,6 @@ int main(int argc, char *argv[]) {
 
 /* TODO */
 	CvMat *P = cvCreateMat(3, 3, CV_32FC1);
-	CvPoint points1[] = { cvPoint(463, 164), cvPoint(530, 357), cvPoint(618, 357), cvPoint(610, 153) };
-	CvPoint points2[] = { cvPoint(225, 179), cvPoint(294, 370), cvPoint(379, 367), cvPoint(369, 168) };
 	CvPoint2D32f pt1[4], pt2[4];
 	for (int i = 0; i < 4; ++i) {
 		pt2[i].x = points2[i].x;
@@ -117,28 +259,9 @@ int main(int argc, char *argv[]) {
 	 */
 
 /* TODO */
-	int h = img1f->height - 1;
-	int w = img1f->width - 1;
-	float p1[] = { 0.0, 0.0, 1.0 };
-	float p2[] = { 0.0, (float)(h), 1.0 };
-	float p3[] = { (float)(w), (float)(h), 1.0 };
-	float p4[] = { (float)(w), 0.0, 1.0 };
-
-	
-	cv::Mat P1 = P * cv::Mat(3, 1, CV_32FC1, p1);
-	cv::Mat P2 = P * cv::Mat(3, 1, CV_32FC1, p2);
-	cv::Mat P3 = P * cv::Mat(3, 1, CV_32FC1, p3);
-	cv::Mat P4 = P * cv::Mat(3, 1, CV_32FC1, p4);
-
-	// mustn't be zero
-	assert(P1.at<float>(2,0) != 0 && P2.at<float>(2,0) != 0 && P3.at<float>(2,0) != 0 && P4.at<float>(2,0) != 0);
-
-	P1 = P1 / P1.at<float>(2,0);
-	P2 = P2 / P2.at<float>(2,0);
-	P3 = P3 / P3.at<float>(2,0);
-	P4 = P4 / P4.at<float>(2,0);
-
-
+	cv::Mat matImg1f(img1f), matImg2f(img2f);
+	cv::Mat H(P);
+	cv::Rect area = projectedBounds(H, matImg1f.size()) | cv::Rect(cv::Point(0, 0), matImg2f.size());
 
 	/**
 	 * - Projiziere das linke Bild in die Bildebene des rechten Bildes. Beachte
@@ -147,75 +270,36 @@ int main(int argc, char *argv[]) {
 	 */
 
 /* TODO */
-	///////// Hier wird irgendwo ein fehler sein bei der Groesse...
-	std::vector<cv::Mat*> matrices;
-	matrices.push_back(&P1);
-	matrices.push_back(&P2);
-	matrices.push_back(&P3);
-	matrices.push_back(&P4);
-	cv::Point minP(P1.at<float>(0,0), P1.at<float>(1,0)), maxP(P1.at<float>(0,0), P1.at<float>(1,0));
-	for(int i = 0; i < matrices.size(); ++i) {
-			minP.x = (int)(min(matrices[i]->at<float>(0,0), (float)minP.x));
-			minP.y = (int)(min(matrices[i]->at<float>(1,0), (float)minP.y));
-
-			maxP.x = (int)(max(matrices[i]->at<float>(0,0), (float)maxP.x)+1.0);
-			maxP.y = (int)(max(matrices[i]->at<float>(1,0), (float)maxP.y)+1.0);
-	}
-
-	minP.x = min(minP.x, 0); minP.y = min(minP.y, 0);
-	maxP.x = max(maxP.x, img1f->width-1); maxP.y = max(maxP.y, img1f->height-1);
-	// create image
-	cv::Mat Panorama = cv::Mat(cv::Size(maxP-minP),  CV_32FC1, cv::Scalar(0.0));
-	cv::Mat PLeft = cv::Mat(cv::Size(maxP-minP),  CV_32FC1, cv::Scalar(0.0));
-	cv::Mat PRight = cv::Mat(cv::Size(maxP-minP),  CV_32FC1, cv::Scalar(0.0));
-
-	cv::Mat matImg1f = cv::Mat( img1f);
-	cv::Mat matImg2f = cv::Mat( img2f);
-	for(int y=0; y < matImg1f.rows; ++y ) {
-		for(int x=0; x < matImg1f.cols; ++x ) {
-			PLeft.at<float>(y,x) = matImg1f.at<float>(y,x);
-		}
-	}
-	for(int y=0; y < matImg2f.rows; ++y ) {
-		for(int x=0; x < matImg2f.cols; ++x ) {
-			PRight.at<float>(y,x) = matImg2f.at<float>(y,x);
-		}
-	}
-
-	
-	cv::imshow("mainWin", PLeft);
+	// nur die Ausschnitte der beiden Bilder werden beschrieben, keine Kopien in Panoramagröße
+	PanoramaCanvas canvas(area);
+	cv::Rect leftRoi = canvas.add(matImg1f, H);
+	cv::imshow("mainWin", canvas.image());
 	cv::waitKey(0);
-	cv::imshow("mainWin", PRight);
+	cv::Rect rightRoi = canvas.add(matImg2f, cv::Mat::eye(3, 3, CV_64F));
+	cv::imshow("mainWin", canvas.image());
 	cv::waitKey(0);
 
-	float trans2[] = { 1.0, 0.0, -minP.x, 0.0, 1.0, -minP.y, 0.0, 0.0, 1.0};
-	cv::Mat translation(3,3,CV_32FC1,trans2);
-	//translate P
-	cv::Mat Pnew = translation*cv::Mat(P);
-	cv::warpPerspective(PLeft, Panorama, Pnew, Panorama.size());
-	cv::warpPerspective(PRight, PLeft, translation, PLeft.size());
-	PRight = PLeft.clone();
-
-	cv::imshow("mainWin", PLeft);
-	cv::waitKey(0);
-	cv::imshow("mainWin", Panorama);
-	cv::waitKey(0);
 	/**
 	 * - Bilde das Panoramabild, so dass Pixel, für die zwei Werte vorhanden sind,
 	 *   den Mittelwert zugeordnet bekommen.
 	 */
 
-	cv::Mat mask = (Panorama > 0.0) & (PLeft > 0.0);
-	cv::imshow("mainWin", mask);
-	cv::waitKey(0);
-
-	mask.convertTo(mask,CV_32FC1, 0.5/255.); 
-	cv::Mat weighted = cv::Mat(Panorama.size(),  CV_32FC1, cv::Scalar(1.0)) - mask;
+	cv::Rect overlap = leftRoi & rightRoi;
+	if (overlap.width > 0 && overlap.height > 0) {
+		cv::imshow("mainWin", canvas.coverage()(overlap) > 1);
+		cv::waitKey(0);
+	}
 
-	Panorama = Panorama + PLeft;
-	cv::multiply(Panorama, weighted, Panorama);
+	cv::imshow("mainWin", canvas.result());
+	cv::waitKey(0);
 
-	cv::imshow("mainWin", Panorama);
+	// zum Vergleich ohne Nähte: Mehrband-Überblendung mit Gewichten nach Abstand zum Bildrand
+	MultiBandBlender blender(area, CV_32FC1);
+	blender.add(matImg1f, H);
+	blender.add(matImg2f, cv::Mat::eye(3, 3, CV_64F));
+	MatWriter blended(area.size(), CV_32FC1);
+	blender.finish(blended);
+	cv::imshow("mainWin", blended.image);
 	cv::waitKey(0);
 /* TODO */
 
@@ -11,7 +11,9 @@
 #include <ctime>
 #include <vector>
 #include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <set>
@@ -21,6 +23,9 @@
 #include <cv.h>
 #include <highgui.h>
 
+#include "../common/blend.h"
+#include "../common/panoramagraph.h"
+
 using namespace std;
 
 class SIFTFeature {
@@ -48,116 +53,23 @@ class SIFTFeature {
  * The Panorama is then displayed.
  */
 void createPanorama(const IplImage *img_l, const IplImage *img_m, CvMat* P) {
-	//Determine size of new image
-	int h = img_l->height - 1;
-	int w = img_l->width - 1;
-	float z1[] = {0.0, 0.0, 1.0 };
-	float z2[] = {0.0, (float)(h), 1.0 };
-	float z3[] = {(float)(w), (float)(h), 1.0 };
-	float z4[] = {(float)(w), 0.0, 1.0 };
-
-	CvMat* Z1 = cvCreateMatHeader(3,1, CV_32FC1);
-	cvSetData( Z1, z1, Z1->step );
-	CvMat* Z2 = cvCreateMatHeader(3,1, CV_32FC1);
-	cvSetData( Z2, z2, Z2->step );
-	CvMat* Z3 = cvCreateMatHeader(3,1, CV_32FC1);
-	cvSetData( Z3, z3, Z3->step );
-	CvMat* Z4 = cvCreateMatHeader(3,1, CV_32FC1);
-	cvSetData( Z4, z4, Z4->step );
-
-	cvMatMul(P, Z1, Z1);
-	cvMatMul(P, Z2, Z2);
-	cvMatMul(P, Z3, Z3);
-	cvMatMul(P, Z4, Z4);
-
-	float z1_z = cvGetReal1D( Z1, 2);
-	float z2_z = cvGetReal1D( Z2, 2);
-	float z3_z = cvGetReal1D( Z3, 2);
-	float z4_z = cvGetReal1D( Z4, 2);
-
-	if ( (z1_z==0) || (z2_z==0) || (z4_z==0) || (z4_z==0)) {
-		throw runtime_error("Invalid homography P specified!");
-	}
-
-	cvScale(Z1, Z1, 1.0 / z1_z);
-	cvScale(Z2, Z2, 1.0 / z2_z);
-	cvScale(Z3, Z3, 1.0 / z3_z);
-	cvScale(Z4, Z4, 1.0 / z4_z);
-
-	CvPoint offmin, offmax;
-	offmin.x = floor( min( min( min( cvmGet(Z1,0,0), cvmGet(Z2,0,0) ), cvmGet(Z3,0,0) ), cvmGet(Z4,0,0) ) );
-	offmin.x = min(0, offmin.x);
-	offmin.y = floor( min( min( min( cvmGet(Z1,1,0), cvmGet(Z2,1,0) ), cvmGet(Z3,1,0) ), cvmGet(Z4,1,0) ) );
-	offmin.y = min(0, offmin.y);
-
-	offmax.x = ceil( max( max( max( cvmGet(Z1,0,0), cvmGet(Z2,0,0) ), cvmGet(Z3,0,0) ), cvmGet(Z4,0,0) ) );
-	offmax.x = max( w, offmax.x);
-	offmax.y = ceil( max( max( max( cvmGet(Z1,1,0), cvmGet(Z2,1,0) ), cvmGet(Z3,1,0) ), cvmGet(Z4,1,0) ) );
-	offmax.y = max( h, offmax.y);
-
-	CvSize s = cvSize(offmax.x - offmin.x, offmax.y - offmin.y);
+	cv::Mat left(img_l), middle(img_m), H(P);
 
-	//Fill the new-size images with data
-	IplImage *Panorama = cvCreateImage(s, IPL_DEPTH_32F, img_l->nChannels);
-	IplImage *P1 = cvCreateImage(s, IPL_DEPTH_32F, img_l->nChannels);
-	IplImage *P2 = cvCreateImage(s, IPL_DEPTH_32F, img_l->nChannels);
-
-	cvZero(P1);
-	cvZero(P2);
-	cvZero(Panorama);
-
-	cvSetImageROI(P1, cvRect(0, 0, img_l->width, img_l->height));
-	cvSetImageROI(P2, cvRect(0, 0, img_m->width, img_m->height));
-
-	cvCopy(img_l, P1);
-	cvCopy(img_m, P2);
-
-	cvResetImageROI(P1);
-	cvResetImageROI(P2);
-
-	cvShowImage("mainWin", P2 );
-	cvWaitKey(0);
-	cvShowImage("mainWin", P1 );
-	cvWaitKey(0);
-
-
-	//Determine projective transformation relative to new image size
-	CvMat* T = cvCreateMatHeader(3, 3, CV_32FC1);
-	float rev_trans[] = { 1.0, 0.0, -offmin.x, 0.0, 1.0, -offmin.y, 0.0, 0.0, 1.0};
-
-	cvSetData( T, rev_trans, T->step);
-
-	cvMatMul(T,P,P);
+	//Determine size of new image
+	cv::Rect area = projectedBounds(H, left.size()) | cv::Rect(cv::Point(0, 0), middle.size());
 
+	//Blend both images band by band, each tile is warped when it is needed
 	cout << "Warp now" << endl;
-	//Create the panorama
-	cvWarpPerspective( P1, Panorama, P );
-	cvWarpPerspective( P2, P1, T);
-	cvCopy( P1, P2);
+	RowBandExecutor executor;
+	MultiBandBlender blender(area, left.type(), 5, 512, &executor);
+	blender.add(left, H);
+	blender.add(middle, cv::Mat::eye(3, 3, CV_64F));
 
-	IplImage* MaskL = cvCreateImage( s, IPL_DEPTH_32F, P1->nChannels);
-	IplImage* MaskM = cvCreateImage( s, IPL_DEPTH_32F, P1->nChannels);
+	MatWriter panorama(area.size(), left.type());
+	blender.finish(panorama);
 
-	cvThreshold(Panorama, MaskL, 0.001, 1.0, CV_THRESH_BINARY );
-	cvThreshold(P2,       MaskM, 0.001, 1.0, CV_THRESH_BINARY );
-
-	cvAdd( Panorama, P2, Panorama );
-	cvAdd( MaskL, MaskM, MaskM );
-	cvDiv( Panorama, MaskM, Panorama);
-
-	cvShowImage("mainWin", Panorama );
-	cvWaitKey(0);
-
-	cvReleaseMat( &Z1);
-	cvReleaseMat( &Z2);
-	cvReleaseMat( &Z3);
-	cvReleaseMat( &Z4);
-	cvReleaseMat( &T);
-	cvReleaseImage( &P1);
-	cvReleaseImage( &P2);
-	cvReleaseImage( &Panorama);
-	cvReleaseImage( &MaskL);
-	cvReleaseImage( &MaskM);
+	cv::imshow("mainWin", panorama.image);
+	cv::waitKey(0);
 }
 
 /*
@@ -269,7 +181,7 @@ int matchDescriptors(const SIFTFeature &feat, const vector<SIFTFeature> &featlis
  *   Abweichung. Bei gleicher Anzahl konsistenter Korrespondenzen entscheidet
  *   die Gesamtabweichung aller gültigen Korrespondenzen.
  */
-void RANSACTransform(const unsigned int &ransac_iterations, const vector<SIFTFeature> &keypoints1, const vector<SIFTFeature> &keypoints2, 
+size_t RANSACTransform(const unsigned int &ransac_iterations, const vector<SIFTFeature> &keypoints1, const vector<SIFTFeature> &keypoints2, 
 		const vector<pair<unsigned int, unsigned int> > &ptpairs, CvMat *P_in) {
 
 /* TODO */
@@ -305,18 +217,16 @@ void RANSACTransform(const unsigned int &ransac_iterations, const vector<SIFTFea
 			std::set<int> also_inliers;
 			int inlier_idx = 0;
 			for(auto it = ptpairs.begin(); it != ptpairs.end(); ++it, ++inlier_idx) {
-				int x1 = keypoints1[it->first].x;
-				int y1 = keypoints1[it->first].y;
-				int x2 = keypoints2[it->second].x;
-				int y2 = keypoints2[it->second].y;
+				CvPoint2D32f p1 = keypoints1[it->first].getPos();
+				CvPoint2D32f p2 = keypoints2[it->second].getPos();
 
-				int data[3] = {x1, y1, 1};
+				float data[3] = {p1.x, p1.y, 1.f};
 				cv::Mat transform = H*cv::Mat(3,1, CV_32FC1, data);
 
-				float dx = transform.at<float>(0,0) / transform.at<float>(2,0) - x2;
-				float dy = transform.at<float>(1,0) / transform.at<float>(2,0) - y2;
+				float dx = transform.at<float>(0,0) / transform.at<float>(2,0) - p2.x;
+				float dy = transform.at<float>(1,0) / transform.at<float>(2,0) - p2.y;
 
-				if(abs(dx) < 4 && abs(dy) < 4) {
+				if(fabs(dx) < 4 && fabs(dy) < 4) {
 					also_inliers.insert(inlier_idx);
 				}
 			}
@@ -326,6 +236,13 @@ void RANSACTransform(const unsigned int &ransac_iterations, const vector<SIFTFea
 			}
 		}
 
+		// too few inliers for a homography: P is the identity, the caller
+		// has to check the returned count
+		if(best_match.size() < 4) {
+			cvSetIdentity(P_in);
+			return best_match.size();
+		}
+
 		std::vector<cv::Point2f> src, dst;
 
 		for(auto it = best_match.begin(); it != best_match.end(); ++it) {
@@ -349,6 +266,7 @@ void RANSACTransform(const unsigned int &ransac_iterations, const vector<SIFTFea
 
 /* TODO */
 
+		return best_match.size();
 }
 
 void findPairs(const vector<SIFTFeature> &keypoints1, const vector<SIFTFeature> &keypoints2, 
@@ -362,9 +280,111 @@ void findPairs(const vector<SIFTFeature> &keypoints1, const vector<SIFTFeature>
 	}
 }
 
+/*
+ * Descriptors of the count features with the largest scale, one per row.
+ * Used as a signature to find candidate pairs among many images.
+ */
+cv::Mat siftSignature(const vector<SIFTFeature> &features, unsigned int count = 100) {
+	vector<pair<float, unsigned int> > byScale;
+	for (unsigned int i = 0; i < features.size(); ++i) {
+		byScale.push_back(make_pair(features[i].scale, i));
+	}
+	sort(byScale.rbegin(), byScale.rend());
+	byScale.resize(min<size_t>(byScale.size(), count));
+
+	cv::Mat signature(byScale.size(), 128, CV_32FC1);
+	for (unsigned int i = 0; i < byScale.size(); ++i) {
+		copy(features[byScale[i].second].descriptor, features[byScale[i].second].descriptor + 128, signature.ptr<float>(i));
+	}
+	return signature;
+}
+
+/*
+ * Stitches all images of a list file (one "<image-file-name> <keyfile>" per
+ * line, in capture order) into one panorama. Only candidate pairs are
+ * registered; the images are chained to the first one through a spanning
+ * tree. Each image is added to a growing tiled canvas as soon as it is
+ * placed (placed images never move), so appending an image never re-renders
+ * the ones before it. The panorama is written tile by tile as PPM at the end.
+ */
+int mosaic(int argc, char *argv[]) {
+	ifstream list(argv[2]);
+	if (!list) {
+		cerr << "Could not open list file: " << argv[2] << endl;
+		return 1;
+	}
+	float ratio = atof(argv[3]);
+
+	vector<string> images;
+	vector<vector<SIFTFeature> > keypoints;
+	PanoramaGraph graph([&](int from, int to, cv::Mat &H, int &inliers) {
+		vector<pair<unsigned int, unsigned int> > ptpairs;
+		findPairs(keypoints[from], keypoints[to], ptpairs, ratio);
+		if (ptpairs.size() < 4) {
+			return false;
+		}
+		CvMat* P = cvCreateMat(3, 3, CV_32FC1);
+		inliers = RANSACTransform(100, keypoints[from], keypoints[to], ptpairs, P);
+		H = cv::Mat(P, true);
+		cvReleaseMat(&P);
+		return inliers >= 4;
+	});
+
+	RowBandExecutor executor;
+	TiledCanvas canvas(cv::Rect(), CV_32FC3, TiledCanvas::DEFAULT_TILE_SIZE, 256, "", &executor);
+	vector<bool> rendered;
+
+	string image, keyfile;
+	while (list >> image >> keyfile) {
+		cv::Mat img = cv::imread(image);
+		if (img.empty()) {
+			cerr << "Could not load image file: " << image << endl;
+			return 1;
+		}
+		images.push_back(image);
+		keypoints.push_back(readSIFT(keyfile));
+		int i = graph.append(img.size(), siftSignature(keypoints.back()));
+		cout << "Image " << i << ": ";
+		if (graph.placed(i)) {
+			cout << "placed via " << graph.parent(i);
+		} else {
+			cout << "not placed";
+		}
+		cout << ", " << graph.placedCount() << " of " << graph.size() << " placed, "
+			<< graph.registrations() << " registrations" << endl;
+
+		// the new image and any images it connected to the reference
+		rendered.push_back(false);
+		for (int j = 0; j < graph.size(); ++j) {
+			if (rendered[j] || !graph.placed(j)) {
+				continue;
+			}
+			cv::Mat imgf;
+			(j == i ? img : cv::imread(images[j])).convertTo(imgf, CV_32F, 1.0/255.0);
+			canvas.add(imgf, graph.transform(j));
+			rendered[j] = true;
+		}
+	}
+	if (graph.size() == 0) {
+		cerr << "No images in " << argv[2] << endl;
+		return 1;
+	}
+
+	cv::Rect area = canvas.bounds();
+	cout << "Panorama " << area.width << "x" << area.height << " from " << graph.placedCount() << " images, "
+		<< graph.registrations() << " of " << graph.size() * (graph.size() - 1) / 2 << " pairs registered" << endl;
+	StripWriter writer(argv[4], area.size(), 3);
+	canvas.finish(writer);
+	return 0;
+}
+
 int main(int argc, char *argv[]) {
+	if (argc >= 5 && strcmp(argv[1], "--mosaic") == 0) {
+		return mosaic(argc, argv);
+	}
 	if (argc <= 5) {
 		cout << "Usage: main <image-file-name1> <image-file-name2> <keyfile1> <keyfile2> <ratio>" << endl;
+		cout << "       main --mosaic <list-file> <ratio> <output.ppm>" << endl;
 		exit(0);
 	}
 
@@ -430,8 +450,17 @@ int main(int argc, char *argv[]) {
 	cvWaitKey(0);
 
 	//Calulate best projective transform with RANSAC
+	if (ptpairs.size() < 4) {
+		cerr << "Not enough matches for a homography (" << ptpairs.size() << " of 4)" << endl;
+		exit(1);
+	}
 	CvMat* P = cvCreateMat(3, 3, CV_32FC1);
-	RANSACTransform(100, keypoints1, keypoints2, ptpairs, P);
+	size_t inliers = RANSACTransform(100, keypoints1, keypoints2, ptpairs, P);
+	cout << "RANSAC: " << inliers << " inliers" << endl;
+	if (inliers < 4) {
+		cerr << "Not enough consistent matches for a homography (" << inliers << " of 4)" << endl;
+		exit(1);
+	}
 	createPanorama(img1f, img2f, P);
 
 	// destroy the window